@@ -50,7 +50,7 @@ int main(int argc, char **argv) {
         filename = Platform::Path::From(args[2]);
     } else {
         fprintf(stderr, "Usage: %s [mode] [filename]\n", args[0].c_str());
-        fprintf(stderr, "Mode can be one of: load.\n");
+        fprintf(stderr, "Mode can be one of: load, load-cached.\n");
         return 1;
     }
 
@@ -70,6 +70,33 @@ int main(int argc, char **argv) {
                 SK.Clear();
                 SS.Clear();
             });
+    } else if(mode == "load-cached") {
+        // Write the regeneration cache beside the file once, and then
+        // measure opening it with that cache.
+        SS.Init();
+        if(SS.LoadFromFile(filename)) {
+            SS.AfterNewFile();
+            SS.SaveRegenCache(filename);
+        }
+        SK.Clear();
+        SS.Clear();
+
+        result = RunBenchmark(
+            [] {
+                SS.Init();
+            },
+            [&] {
+                if(!SS.LoadFromFile(filename))
+                    return false;
+                if(!SS.LoadRegenCache(filename))
+                    return false;
+                SS.AfterNewFile();
+                return true;
+            },
+            [] {
+                SK.Clear();
+                SS.Clear();
+            });
     } else {
         fprintf(stderr, "Unknown mode \"%s\"\n", mode.c_str());
     }
@@ -189,11 +189,57 @@ typedef struct {
 #define SLVS_RESULT_INCONSISTENT        1
 #define SLVS_RESULT_DIDNT_CONVERGE      2
 #define SLVS_RESULT_TOO_MANY_UNKNOWNS   3
+#define SLVS_RESULT_CANCELLED           4
+#define SLVS_RESULT_UNRECOGNIZED        5
     int                 result;
 } Slvs_System;
 
 DLL void Slvs_Solve(Slvs_System *sys, Slvs_hGroup hg);
 
+/* A context holds everything that the solver keeps between calls. Solves in
+ * different contexts are independent, and may run at the same time in
+ * different threads; a context must only be used by one thread at a time.
+ * Slvs_Solve() uses a context that belongs to the calling thread. */
+typedef struct Slvs_Context Slvs_Context;
+
+DLL Slvs_Context *Slvs_CreateContext(void);
+DLL void Slvs_DestroyContext(Slvs_Context *ctx);
+DLL void Slvs_SolveInContext(Slvs_Context *ctx, Slvs_System *sys, Slvs_hGroup hg);
+
+/* Ask the solve that's running in ctx, or the next one to start if none is,
+ * to stop as soon as it can; that solve leaves the params as they were, and
+ * its result is SLVS_RESULT_CANCELLED. This may be called from any thread. */
+DLL void Slvs_CancelContext(Slvs_Context *ctx);
+
+/* Solve the same system from each of count sets of values for its params,
+ * where vals[k*sys->params + i] is the value of sys->param[i] in set k; the
+ * solution for each set is written back in to vals[]. The equations are
+ * written and differentiated once, and the sets are solved concurrently.
+ * The result and dof for set k go in result[k] and dof[k], if those aren't
+ * NULL. The values in sys->param[] are ignored, and sys->failed is not
+ * filled in. */
+DLL void Slvs_SolveBatch(Slvs_System *sys, Slvs_hGroup hg,
+                         int count, double *vals, int *result, int *dof);
+DLL void Slvs_SolveBatchInContext(Slvs_Context *ctx, Slvs_System *sys, Slvs_hGroup hg,
+                                  int count, double *vals, int *result, int *dof);
+
+/* Step the value of constraint hc's dimension (its valA) evenly from
+ * valStart to valEnd, over steps values, and solve the system at each; the
+ * equations are written and differentiated once, and each step starts from
+ * the last solution found. After each step, sys->param[] holds its solution,
+ * sys->result and sys->dof are set, and callback is called with the step
+ * number and the dimension's value; it returns nonzero to stop the sweep.
+ * The callback must not change sys, and sys->failed is not filled in. */
+typedef int (*Slvs_SweepCallback)(void *data, int step, double val,
+                                  const Slvs_System *sys);
+
+DLL void Slvs_Sweep(Slvs_System *sys, Slvs_hGroup hg, Slvs_hConstraint hc,
+                    double valStart, double valEnd, int steps,
+                    Slvs_SweepCallback callback, void *data);
+DLL void Slvs_SweepInContext(Slvs_Context *ctx, Slvs_System *sys, Slvs_hGroup hg,
+                             Slvs_hConstraint hc, double valStart, double valEnd,
+                             int steps, Slvs_SweepCallback callback, void *data);
+
 
 /* Our base coordinate system has basis vectors
  *     (1, 0, 0)  (0, 1, 0)  (0, 0, 1)
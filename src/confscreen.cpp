@@ -94,6 +94,11 @@ void TextWindow::ScreenChangeCheckClosedContour(int link, uint32_t v) {
     InvalidateGraphics();
 }
 
+void TextWindow::ScreenChangeRegenCache(int link, uint32_t v) {
+    SS.regenCache = !SS.regenCache;
+    InvalidateGraphics();
+}
+
 void TextWindow::ScreenChangeShadedTriangles(int link, uint32_t v) {
     SS.exportShadedTriangles = !SS.exportShadedTriangles;
     InvalidateGraphics();
@@ -305,6 +310,9 @@ void TextWindow::ShowConfiguration() {
     Printf(false, "  %Fd%f%Ll%s  show areas of closed contours%E",
         &ScreenChangeShowContourAreas,
         SS.showContourAreas ? CHECK_TRUE : CHECK_FALSE);
+    Printf(false, "  %Fd%f%Ll%s  keep solid model in a file beside sketch%E",
+        &ScreenChangeRegenCache,
+        SS.regenCache ? CHECK_TRUE : CHECK_FALSE);
 
     Printf(false, "");
     Printf(false, "%Ft autosave interval (in minutes)%E");
@@ -268,14 +268,22 @@ public:
 
 // A list, where each element has an integer identifier. The list is kept
 // sorted by that identifier, and items can be looked up in log n time by
-// id.
-template <class T, class H>
+// id. If Indexed, then there's also a hash table from each identifier to
+// its element's index, so that lookups take constant time; that's for the
+// big lists that are searched all the time, like the params and entities.
+template <class T, class H, bool Indexed = false>
 class IdList {
 public:
     T     *elem;
     int   n;
     int   elemsAllocated;
 
+    // Open addressing with linear probing; each slot holds an index in to
+    // elem[], or -1 if empty. There are twice as many slots as elements
+    // allocated, so the table is never more than half full.
+    int   *index;
+    int   indexSize;
+
     uint32_t MaximumId() {
         if(n == 0) {
             return 0;
@@ -291,6 +299,34 @@ public:
         return t->h;
     }
 
+    static int IndexSlot(uint32_t v, int size) {
+        return (int)((v * 2654435761u) & (uint32_t)(size - 1));
+    }
+
+    void IndexInsert(uint32_t v, int i) {
+        int slot = IndexSlot(v, indexSize);
+        while(index[slot] >= 0) {
+            slot = (slot + 1) & (indexSize - 1);
+        }
+        index[slot] = i;
+    }
+
+    void RebuildIndex() {
+        if(!Indexed || elemsAllocated == 0) return;
+
+        int size = 16;
+        while(size < 2*elemsAllocated) size *= 2;
+        if(size != indexSize) {
+            if(index) MemFree(index);
+            index = (int *)MemAlloc((size_t)size*sizeof(index[0]));
+            indexSize = size;
+        }
+        std::fill(index, index + indexSize, -1);
+        for(int i = 0; i < n; i++) {
+            IndexInsert(elem[i].h.v, i);
+        }
+    }
+
     void ReserveMore(int howMuch) {
         if(n + howMuch > elemsAllocated) {
             elemsAllocated = n + howMuch;
@@ -301,6 +337,7 @@ public:
             }
             MemFree(elem);
             elem = newElem;
+            RebuildIndex();
         }
     }
 
@@ -308,8 +345,12 @@ public:
         if(n >= elemsAllocated) {
             ReserveMore((elemsAllocated + 32)*2 - n);
         }
-    
+
         int first = 0, last = n;
+        if(n > 0 && elem[n - 1].h.v < t->h.v) {
+            // The usual case, where the new handle is the biggest yet
+            first = last = n;
+        }
         // We know that we must insert within the closed interval [first,last]
         while(first != last) {
             int mid = (first + last)/2;
@@ -327,6 +368,37 @@ public:
         std::move_backward(elem + i, elem + n, elem + n + 1);
         elem[i] = *t;
         n++;
+
+        if(Indexed) {
+            if(i < n - 1) {
+                // Everything after the new element moved up by one.
+                for(int slot = 0; slot < indexSize; slot++) {
+                    if(index[slot] >= i) index[slot]++;
+                }
+            }
+            IndexInsert(t->h.v, i);
+        }
+    }
+
+    // Append an element without keeping the list sorted, which is much
+    // faster when building a big list in no particular order; the list can't
+    // be searched or added to until SortById() is called.
+    void AddUnsorted(T *t) {
+        if(n >= elemsAllocated) {
+            ReserveMore((elemsAllocated + 32)*2 - n);
+        }
+        new(&elem[n]) T(*t);
+        n++;
+    }
+
+    void SortById() {
+        std::sort(begin(), end(), [](const T &a, const T &b) {
+            return a.h.v < b.h.v;
+        });
+        for(int i = 1; i < n; i++) {
+            ssassert(elem[i - 1].h.v != elem[i].h.v, "Handle isn't unique");
+        }
+        RebuildIndex();
     }
 
     T *FindById(H h) {
@@ -336,6 +408,16 @@ public:
     }
 
     int IndexOf(H h) {
+        if(Indexed) {
+            if(n == 0) return -1;
+            int slot = IndexSlot(h.v, indexSize);
+            while(index[slot] >= 0) {
+                if(elem[index[slot]].h.v == h.v) return index[slot];
+                slot = (slot + 1) & (indexSize - 1);
+            }
+            return -1;
+        }
+
         int first = 0, last = n-1;
         while(first <= last) {
             int mid = (first + last)/2;
@@ -352,19 +434,8 @@ public:
     }
 
     T *FindByIdNoOops(H h) {
-        int first = 0, last = n-1;
-        while(first <= last) {
-            int mid = (first + last)/2;
-            H hm = elem[mid].h;
-            if(hm.v > h.v) {
-                last = mid-1; // and first stays the same
-            } else if(hm.v < h.v) {
-                first = mid+1; // and last stays the same
-            } else {
-                return &(elem[mid]);
-            }
-        }
-        return NULL;
+        int i = IndexOf(h);
+        return (i < 0) ? NULL : &(elem[i]);
     }
 
     T *First() {
@@ -389,12 +460,9 @@ public:
     }
 
     void Tag(H h, int tag) {
-        int i;
-        for(i = 0; i < n; i++) {
-            if(elem[i].h.v == h.v) {
-                elem[i].tag = tag;
-            }
-        }
+        // Handles are unique, so there's at most one.
+        T *t = FindByIdNoOops(h);
+        if(t) t->tag = tag;
     }
 
     void RemoveTagged() {
@@ -415,27 +483,62 @@ public:
             elem[i].~T();
         n = dest;
         // and elemsAllocated is untouched, because we didn't resize
+        RebuildIndex();
+    }
+    // Remove every element whose handle is in hs, compacting the list just
+    // once for all of them; a handle may be in hs more than once.
+    void RemoveByIds(const std::vector<H> &hs) {
+        if(hs.empty()) return;
+
+        std::vector<bool> remove(n, false);
+        for(H h : hs) {
+            int i = IndexOf(h);
+            ssassert(i >= 0, "Cannot find handle");
+            remove[i] = true;
+        }
+        int dest = 0;
+        for(int src = 0; src < n; src++) {
+            if(remove[src]) {
+                elem[src].Clear();
+            } else {
+                if(src != dest) {
+                    elem[dest] = std::move(elem[src]);
+                }
+                dest++;
+            }
+        }
+        for(int i = dest; i < n; i++)
+            elem[i].~T();
+        n = dest;
+        RebuildIndex();
     }
     void RemoveById(H h) {
-        ClearTags();
-        FindById(h)->tag = 1;
-        RemoveTagged();
+        int i = IndexOf(h);
+        ssassert(i >= 0, "Cannot find handle");
+        elem[i].Clear();
+        std::move(elem + i + 1, elem + n, elem + i);
+        elem[n - 1].~T();
+        n--;
+        RebuildIndex();
     }
 
-    void MoveSelfInto(IdList<T,H> *l) {
+    void MoveSelfInto(IdList *l) {
         l->Clear();
         *l = *this;
         elemsAllocated = n = 0;
         elem = NULL;
+        indexSize = 0;
+        index = NULL;
     }
 
-    void DeepCopyInto(IdList<T,H> *l) {
+    void DeepCopyInto(IdList *l) {
         l->Clear();
         l->elem = (T *)MemAlloc(elemsAllocated * sizeof(elem[0]));
         for(int i = 0; i < n; i++)
             new(&l->elem[i]) T(elem[i]);
         l->elemsAllocated = elemsAllocated;
         l->n = n;
+        l->RebuildIndex();
     }
 
     void Clear() {
@@ -446,6 +549,9 @@ public:
         elemsAllocated = n = 0;
         if(elem) MemFree(elem);
         elem = NULL;
+        indexSize = 0;
+        if(index) MemFree(index);
+        index = NULL;
     }
 
 };
@@ -211,13 +211,63 @@ Expr *ExprQuaternion::Magnitude() const {
 }
 
 
-Expr *Expr::From(hParam p) {
-    Expr *r = AllocExpr();
-    r->op = Op::PARAM;
-    r->parh = p;
+//-----------------------------------------------------------------------------
+// The table of interned nodes, keyed by their operation and operands.
+//-----------------------------------------------------------------------------
+namespace {
+struct ExprKey {
+    Expr::Op    op;
+    Expr       *a;
+    uint64_t    b;
+
+    bool operator==(const ExprKey &other) const {
+        return op == other.op && a == other.a && b == other.b;
+    }
+};
+
+struct ExprKeyHash {
+    size_t operator()(const ExprKey &k) const {
+        uint64_t h = (uint64_t)k.op;
+        h = h * 0x9e3779b97f4a7c15ULL + (uint64_t)(uintptr_t)k.a;
+        h = h * 0x9e3779b97f4a7c15ULL + k.b;
+        return (size_t)(h ^ (h >> 29));
+    }
+};
+
+std::unordered_map<ExprKey, Expr *, ExprKeyHash> *InternTable() {
+    static thread_local std::unordered_map<ExprKey, Expr *, ExprKeyHash> table;
+    return &table;
+}
+}
+
+Expr *Expr::Intern(Op op, Expr *a, uint64_t b) {
+    Expr *&r = (*InternTable())[{ op, a, b }];
+    if(r == NULL) {
+        r = AllocExpr();
+        r->op = op;
+        r->a = a;
+        switch(op) {
+            case Op::PARAM:     r->parh.v = (uint32_t)b;            break;
+            case Op::PARAM_PTR: r->parp = (Param *)(uintptr_t)b;    break;
+            case Op::CONSTANT:  memcpy(&r->v, &b, sizeof(r->v));    break;
+            default:            r->b = (Expr *)(uintptr_t)b;        break;
+        }
+    }
     return r;
 }
 
+void Expr::ForgetInterned() {
+    InternTable()->clear();
+}
+
+Expr *Expr::From(hParam p) {
+    return Intern(Op::PARAM, NULL, p.v);
+}
+
+Expr *Expr::From(Param *p) {
+    return Intern(Op::PARAM_PTR, NULL, (uint64_t)(uintptr_t)p);
+}
+
 Expr *Expr::From(double v) {
     // Statically allocate common constants.
     // Note: this is only valid because AllocExpr() uses AllocTemporary(),
@@ -248,18 +298,13 @@ Expr *Expr::From(double v) {
         return &mhalf;
     }
 
-    Expr *r = AllocExpr();
-    r->op = Op::CONSTANT;
-    r->v = v;
-    return r;
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return Intern(Op::CONSTANT, NULL, bits);
 }
 
 Expr *Expr::AnyOp(Op newOp, Expr *b) {
-    Expr *r = AllocExpr();
-    r->op = newOp;
-    r->a = this;
-    r->b = b;
-    return r;
+    return Intern(newOp, this, (uint64_t)(uintptr_t)b);
 }
 
 int Expr::Children() const {
@@ -306,10 +351,9 @@ Expr *Expr::DeepCopy() const {
     return n;
 }
 
-Expr *Expr::DeepCopyWithParamsAsPointers(IdList<Param,hParam> *firstTry,
-    IdList<Param,hParam> *thenTry) const
+Expr *Expr::DeepCopyWithParamsAsPointers(ParamList *firstTry,
+    ParamList *thenTry) const
 {
-    Expr *n = AllocExpr();
     if(op == Op::PARAM) {
         // A param that is referenced by its hParam gets rewritten to go
         // straight in to the parameter table with a pointer, or simply
@@ -317,20 +361,21 @@ Expr *Expr::DeepCopyWithParamsAsPointers(IdList<Param,hParam> *firstTry,
         Param *p = firstTry->FindByIdNoOops(parh);
         if(!p) p = thenTry->FindById(parh);
         if(p->known) {
-            n->op = Op::CONSTANT;
-            n->v = p->val;
+            return From(p->val);
         } else {
-            n->op = Op::PARAM_PTR;
-            n->parp = p;
+            return From(p);
         }
-        return n;
     }
 
-    *n = *this;
-    int c = n->Children();
-    if(c > 0) n->a = a->DeepCopyWithParamsAsPointers(firstTry, thenTry);
-    if(c > 1) n->b = b->DeepCopyWithParamsAsPointers(firstTry, thenTry);
-    return n;
+    // The copy is built from interned nodes too, so shared subexpressions
+    // stay shared.
+    switch(Children()) {
+        case 0: return (Expr *)this;
+        case 1: return a->DeepCopyWithParamsAsPointers(firstTry, thenTry)->AnyOp(op, NULL);
+        case 2: return a->DeepCopyWithParamsAsPointers(firstTry, thenTry)->AnyOp(op,
+                       b->DeepCopyWithParamsAsPointers(firstTry, thenTry));
+        default: ssassert(false, "Unexpected children count");
+    }
 }
 
 double Expr::Eval() const {
@@ -357,6 +402,184 @@ double Expr::Eval() const {
     ssassert(false, "Unexpected operation");
 }
 
+//-----------------------------------------------------------------------------
+// Compiling expressions to a tape, and evaluating that tape.
+//-----------------------------------------------------------------------------
+void ExprParams::Clear() {
+    param.clear();
+    val.clear();
+    slot.clear();
+}
+
+uint32_t ExprParams::SlotFor(Param *p) {
+    auto it = slot.find(p);
+    if(it != slot.end()) return it->second;
+    uint32_t k = (uint32_t)param.size();
+    param.push_back(p);
+    val.push_back(p->val);
+    slot[p] = k;
+    return k;
+}
+
+void ExprParams::Gather() {
+    for(size_t k = 0; k < param.size(); k++) {
+        val[k] = param[k]->val;
+    }
+}
+
+void ExprParams::Scatter(size_t n) {
+    for(size_t k = 0; k < n; k++) {
+        param[k]->val = val[k];
+    }
+}
+
+void ExprParams::Rebase(const Param *from, Param *to, int n) {
+    slot.clear();
+    for(size_t k = 0; k < param.size(); k++) {
+        if(param[k] >= from && param[k] < from + n) {
+            param[k] = to + (param[k] - from);
+        }
+        slot[param[k]] = (uint32_t)k;
+    }
+}
+
+void ExprTape::Clear() {
+    code.clear();
+    reg.clear();
+    out.clear();
+    codeStart.clear();
+    regStart.clear();
+    memo.clear();
+}
+
+size_t ExprTape::Add(const Expr *e, ExprParams *params) {
+    codeStart.push_back((uint32_t)code.size());
+    regStart.push_back((uint32_t)reg.size());
+    memo.clear();
+    out.push_back(Compile(e, params));
+    return out.size() - 1;
+}
+
+uint32_t ExprTape::Compile(const Expr *e, ExprParams *params) {
+    auto it = memo.find(e);
+    if(it != memo.end()) return it->second;
+
+    Instr in = {};
+    in.op = e->op;
+    switch(e->op) {
+        case Expr::Op::PARAM:
+            in.op = Expr::Op::PARAM_PTR;
+            in.a  = params->SlotFor(SK.GetParam(e->parh));
+            break;
+        case Expr::Op::PARAM_PTR:
+            in.a  = params->SlotFor(e->parp);
+            break;
+
+        case Expr::Op::CONSTANT:
+            break;
+        case Expr::Op::VARIABLE:
+            ssassert(false, "Not supported yet");
+
+        case Expr::Op::PLUS:
+        case Expr::Op::MINUS:
+        case Expr::Op::TIMES:
+        case Expr::Op::DIV:
+            in.a = Compile(e->a, params);
+            in.b = Compile(e->b, params);
+            break;
+
+        case Expr::Op::NEGATE:
+        case Expr::Op::SQRT:
+        case Expr::Op::SQUARE:
+        case Expr::Op::SIN:
+        case Expr::Op::COS:
+        case Expr::Op::ASIN:
+        case Expr::Op::ACOS:
+            in.a = Compile(e->a, params);
+            break;
+    }
+
+    in.r = (uint32_t)reg.size();
+    if(e->op == Expr::Op::CONSTANT) {
+        reg.push_back(e->v);
+    } else {
+        reg.push_back(0.0);
+        code.push_back(in);
+    }
+    memo[e] = in.r;
+    return in.r;
+}
+
+void ExprTape::Eval(const double *val, double *result) {
+    double *r = reg.data();
+    for(const Instr &in : code) {
+        switch(in.op) {
+            case Expr::Op::PARAM_PTR:   r[in.r] = val[in.a];               break;
+
+            case Expr::Op::PLUS:        r[in.r] = r[in.a] + r[in.b];        break;
+            case Expr::Op::MINUS:       r[in.r] = r[in.a] - r[in.b];        break;
+            case Expr::Op::TIMES:       r[in.r] = r[in.a] * r[in.b];        break;
+            case Expr::Op::DIV:         r[in.r] = r[in.a] / r[in.b];        break;
+
+            case Expr::Op::NEGATE:      r[in.r] = -r[in.a];                 break;
+            case Expr::Op::SQRT:        r[in.r] = sqrt(r[in.a]);            break;
+            case Expr::Op::SQUARE:      r[in.r] = r[in.a] * r[in.a];        break;
+            case Expr::Op::SIN:         r[in.r] = sin(r[in.a]);             break;
+            case Expr::Op::COS:         r[in.r] = cos(r[in.a]);             break;
+            case Expr::Op::ASIN:        r[in.r] = asin(r[in.a]);            break;
+            case Expr::Op::ACOS:        r[in.r] = acos(r[in.a]);            break;
+
+            case Expr::Op::PARAM:
+            case Expr::Op::CONSTANT:
+            case Expr::Op::VARIABLE:
+                ssassert(false, "Unexpected operation on tape");
+        }
+    }
+    for(size_t i = 0; i < out.size(); i++) {
+        result[i] = r[out[i]];
+    }
+}
+
+void ExprTape::Adjoint(size_t i) {
+    size_t codeEnd = (i + 1 < out.size()) ? codeStart[i + 1] : code.size();
+    size_t regEnd  = (i + 1 < out.size()) ? regStart[i + 1]  : reg.size();
+
+    adj.resize(reg.size());
+    std::fill(adj.begin() + regStart[i], adj.begin() + regEnd, 0.0);
+    adj[out[i]] = 1.0;
+
+    const double *r = reg.data();
+    double *d = adj.data();
+    for(size_t c = codeEnd; c > codeStart[i]; c--) {
+        const Instr &in = code[c - 1];
+        double g = d[in.r];
+        if(g == 0.0) continue;
+        switch(in.op) {
+            case Expr::Op::PARAM_PTR:                                           break;
+
+            case Expr::Op::PLUS:    d[in.a] += g;   d[in.b] += g;               break;
+            case Expr::Op::MINUS:   d[in.a] += g;   d[in.b] -= g;               break;
+            case Expr::Op::TIMES:   d[in.a] += g*r[in.b];
+                                    d[in.b] += g*r[in.a];                       break;
+            case Expr::Op::DIV:     d[in.a] += g/r[in.b];
+                                    d[in.b] -= g*r[in.r]/r[in.b];               break;
+
+            case Expr::Op::NEGATE:  d[in.a] -= g;                               break;
+            case Expr::Op::SQRT:    d[in.a] += g*0.5/r[in.r];                   break;
+            case Expr::Op::SQUARE:  d[in.a] += g*2*r[in.a];                     break;
+            case Expr::Op::SIN:     d[in.a] += g*cos(r[in.a]);                  break;
+            case Expr::Op::COS:     d[in.a] -= g*sin(r[in.a]);                  break;
+            case Expr::Op::ASIN:    d[in.a] += g/sqrt(1 - r[in.a]*r[in.a]);     break;
+            case Expr::Op::ACOS:    d[in.a] -= g/sqrt(1 - r[in.a]*r[in.a]);     break;
+
+            case Expr::Op::PARAM:
+            case Expr::Op::CONSTANT:
+            case Expr::Op::VARIABLE:
+                ssassert(false, "Unexpected operation on tape");
+        }
+    }
+}
+
 Expr *Expr::PartialWrt(hParam p) const {
     Expr *da, *db;
 
@@ -400,15 +623,19 @@ Expr *Expr::PartialWrt(hParam p) const {
     ssassert(false, "Unexpected operation");
 }
 
-uint64_t Expr::ParamsUsed() const {
-    uint64_t r = 0;
-    if(op == Op::PARAM)     r |= ((uint64_t)1 << (parh.v % 61));
-    if(op == Op::PARAM_PTR) r |= ((uint64_t)1 << (parp->h.v % 61));
+void Expr::ParamsUsedList(std::vector<hParam> *list) const {
+    if(op == Op::PARAM || op == Op::PARAM_PTR) {
+        hParam p = (op == Op::PARAM) ? parh : parp->h;
+        for(hParam &lp : *list) {
+            if(lp.v == p.v) return;
+        }
+        list->push_back(p);
+        return;
+    }
 
     int c = Children();
-    if(c >= 1)          r |= a->ParamsUsed();
-    if(c >= 2)          r |= b->ParamsUsed();
-    return r;
+    if(c >= 1)          a->ParamsUsedList(list);
+    if(c >= 2)          b->ParamsUsedList(list);
 }
 
 bool Expr::DependsOn(hParam p) const {
@@ -421,16 +648,17 @@ bool Expr::DependsOn(hParam p) const {
     return false;
 }
 
-bool Expr::Tol(double a, double b) {
-    return fabs(a - b) < 0.001;
-}
 Expr *Expr::FoldConstants() {
-    Expr *n = AllocExpr();
-    *n = *this;
-
     int c = Children();
-    if(c >= 1) n->a = a->FoldConstants();
-    if(c >= 2) n->b = b->FoldConstants();
+    if(c == 0) return this;
+
+    Expr *fa = a->FoldConstants();
+    Expr *fb = (c >= 2) ? b->FoldConstants() : NULL;
+
+    // The folded node, evaluated as-is if its operands are known
+    Expr n = *this;
+    n.a = fa;
+    if(c >= 2) n.b = fb;
 
     switch(op) {
         case Op::PARAM_PTR:
@@ -444,34 +672,31 @@ Expr *Expr::FoldConstants() {
         case Op::DIV:
         case Op::PLUS:
             // If both ops are known, then we can evaluate immediately
-            if(n->a->op == Op::CONSTANT && n->b->op == Op::CONSTANT) {
-                double nv = n->Eval();
-                n->op = Op::CONSTANT;
-                n->v = nv;
-                break;
+            if(fa->op == Op::CONSTANT && fb->op == Op::CONSTANT) {
+                return From(n.Eval());
             }
-            // x + 0 = 0 + x = x
-            if(op == Op::PLUS && n->b->op == Op::CONSTANT && Tol(n->b->v, 0)) {
-                *n = *(n->a); break;
+            // x + 0 = 0 + x = x. These are exact, since a constant may be a
+            // known param, and a small but real offset mustn't be dropped.
+            if(op == Op::PLUS && fb->op == Op::CONSTANT && fb->v == 0.0) {
+                return fa;
             }
-            if(op == Op::PLUS && n->a->op == Op::CONSTANT && Tol(n->a->v, 0)) {
-                *n = *(n->b); break;
+            if(op == Op::PLUS && fa->op == Op::CONSTANT && fa->v == 0.0) {
+                return fb;
             }
             // 1*x = x*1 = x
-            if(op == Op::TIMES && n->b->op == Op::CONSTANT && Tol(n->b->v, 1)) {
-                *n = *(n->a); break;
+            if(op == Op::TIMES && fb->op == Op::CONSTANT && fb->v == 1.0) {
+                return fa;
             }
-            if(op == Op::TIMES && n->a->op == Op::CONSTANT && Tol(n->a->v, 1)) {
-                *n = *(n->b); break;
+            if(op == Op::TIMES && fa->op == Op::CONSTANT && fa->v == 1.0) {
+                return fb;
             }
             // 0*x = x*0 = 0
-            if(op == Op::TIMES && n->b->op == Op::CONSTANT && Tol(n->b->v, 0)) {
-                n->op = Op::CONSTANT; n->v = 0; break;
+            if(op == Op::TIMES && fb->op == Op::CONSTANT && fb->v == 0.0) {
+                return From(0.0);
             }
-            if(op == Op::TIMES && n->a->op == Op::CONSTANT && Tol(n->a->v, 0)) {
-                n->op = Op::CONSTANT; n->v = 0; break;
+            if(op == Op::TIMES && fa->op == Op::CONSTANT && fa->v == 0.0) {
+                return From(0.0);
             }
-
             break;
 
         case Op::SQRT:
@@ -481,25 +706,30 @@ Expr *Expr::FoldConstants() {
         case Op::COS:
         case Op::ASIN:
         case Op::ACOS:
-            if(n->a->op == Op::CONSTANT) {
-                double nv = n->Eval();
-                n->op = Op::CONSTANT;
-                n->v = nv;
+            if(fa->op == Op::CONSTANT) {
+                return From(n.Eval());
             }
             break;
     }
-    return n;
+    if(fa == a && (c < 2 || fb == b)) return this;
+    return fa->AnyOp(op, fb);
 }
 
-void Expr::Substitute(hParam oldh, hParam newh) {
+Expr *Expr::Substitute(hParam oldh, hParam newh) {
     ssassert(op != Op::PARAM_PTR, "Expected an expression that refer to params via handles");
 
-    if(op == Op::PARAM && parh.v == oldh.v) {
-        parh = newh;
+    if(op == Op::PARAM) {
+        return (parh.v == oldh.v) ? From(newh) : this;
     }
     int c = Children();
-    if(c >= 1) a->Substitute(oldh, newh);
-    if(c >= 2) b->Substitute(oldh, newh);
+    if(c == 0) return this;
+
+    // The nodes may be shared with other expressions, so build new ones
+    // instead of modifying them.
+    Expr *sa = a->Substitute(oldh, newh);
+    Expr *sb = (c >= 2) ? b->Substitute(oldh, newh) : NULL;
+    if(sa == a && (c < 2 || sb == b)) return this;
+    return sa->AnyOp(op, sb);
 }
 
 //-----------------------------------------------------------------------------
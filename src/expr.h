@@ -51,8 +51,16 @@ public:
     static inline Expr *AllocExpr()
         { return (Expr *)AllocTemporary(sizeof(Expr)); }
 
+    // The nodes built by From() and AnyOp() are interned, so that an
+    // expression is a DAG in which structurally identical subexpressions are
+    // shared; so they must never be modified in place. The intern table
+    // points in to temporary memory, and is forgotten when that is freed.
+    static Expr *Intern(Op op, Expr *a, uint64_t b);
+    static void ForgetInterned();
+
     static Expr *From(hParam p);
     static Expr *From(double v);
+    static Expr *From(Param *p);
 
     Expr *AnyOp(Op op, Expr *b);
     inline Expr *Plus (Expr *b_) { return AnyOp(Op::PLUS,  b_); }
@@ -70,11 +78,10 @@ public:
 
     Expr *PartialWrt(hParam p) const;
     double Eval() const;
-    uint64_t ParamsUsed() const;
+    void ParamsUsedList(std::vector<hParam> *list) const;
     bool DependsOn(hParam p) const;
-    static bool Tol(double a, double b);
     Expr *FoldConstants();
-    void Substitute(hParam oldh, hParam newh);
+    Expr *Substitute(hParam oldh, hParam newh);
 
     static const hParam NO_PARAMS, MULTIPLE_PARAMS;
     hParam ReferencedParams(ParamList *pl) const;
@@ -93,8 +100,8 @@ public:
     // Make a copy, with the parameters (usually referenced by hParam)
     // resolved to pointers to the actual value. This speeds things up
     // considerably.
-    Expr *DeepCopyWithParamsAsPointers(IdList<Param,hParam> *firstTry,
-                                       IdList<Param,hParam> *thenTry) const;
+    Expr *DeepCopyWithParamsAsPointers(ParamList *firstTry,
+                                       ParamList *thenTry) const;
 
     static Expr *Parse(const char *input, std::string *error);
     static Expr *From(const char *in, bool popUpError);
@@ -137,4 +144,74 @@ public:
 
     Expr *Magnitude() const;
 };
+
+// The params that some compiled tapes load, each given a slot in one dense
+// array of values. A load on the tape is an index in to that array, so the
+// values are gathered from the param tables once, contiguously, and a solver
+// can step its unknowns there in place; the params are referenced by
+// pointer, so that's valid only as long as the param tables don't move.
+class ExprParams {
+public:
+    std::vector<Param *>    param;
+    std::vector<double>     val;
+    std::unordered_map<const Param *, uint32_t> slot;
+
+    void Clear();
+    // The slot for p, appending one if it hasn't got one yet.
+    uint32_t SlotFor(Param *p);
+    // Copy every param's value in to its slot.
+    void Gather();
+    // Copy the values in the first n slots back out to their params.
+    void Scatter(size_t n);
+    // Point the slots for the n params at from[] at the ones with the same
+    // index in to[] instead, for a copy that solves a copy of the param
+    // table.
+    void Rebase(const Param *from, Param *to, int n);
+};
+
+// A list of expressions, compiled to a flat sequence of instructions on
+// numbered registers. Evaluating that is much faster than walking the trees,
+// since the instructions are contiguous in memory, and a node that's shared
+// within one expression is computed only once.
+class ExprTape {
+public:
+    struct Instr {
+        Expr::Op    op;
+        uint32_t    r;      // destination register
+        uint32_t    a, b;   // operand registers, or the slot of a load
+    };
+
+    std::vector<Instr>      code;
+    // The constants are loaded in to their registers when compiled, so only
+    // the parameters and the operations appear in the code.
+    std::vector<double>     reg;
+    // The register that holds the value of each expression
+    std::vector<uint32_t>   out;
+    // Each expression's code and registers are contiguous, starting here
+    std::vector<uint32_t>   codeStart;
+    std::vector<uint32_t>   regStart;
+
+    // The partials of one expression with respect to each of its registers
+    std::vector<double>     adj;
+
+    // The register for each node of the expression being compiled; it's not
+    // kept across expressions, so that each one's code stands alone.
+    std::unordered_map<const Expr *, uint32_t> memo;
+
+    void Clear();
+    // Add an expression to the tape, returning its index in the output; the
+    // params that it loads are given slots in params.
+    size_t Add(const Expr *e, ExprParams *params);
+    // Evaluate everything with the param values val[], laid out by the
+    // slots in the ExprParams that it was compiled with, writing the value
+    // of each expression to result[].
+    void Eval(const double *val, double *result);
+    // Find the partials of expression i with respect to each register that
+    // it uses, by a reverse sweep over its code; so the partial with respect
+    // to a parameter is the sum of adj[] over the registers that load it.
+    // The tape must already have been evaluated at the point of interest.
+    void Adjoint(size_t i);
+
+    uint32_t Compile(const Expr *e, ExprParams *params);
+};
 #endif
@@ -13,45 +13,129 @@ void SolveSpaceUI::MarkGroupDirtyByEntity(hEntity he) {
     MarkGroupDirty(e->group);
 }
 
-void SolveSpaceUI::MarkGroupDirty(hGroup hg, bool onlyThis) {
-    int i;
-    bool go = false;
-    for(i = 0; i < SK.groupOrder.n; i++) {
-        Group *g = SK.GetGroup(SK.groupOrder.elem[i]);
-        if(g->h.v == hg.v) {
-            go = true;
-        }
-        if(go) {
-            g->clean = false;
-            if(onlyThis) break;
-        }
-    }
+void SolveSpaceUI::MarkGroupDirty(hGroup hg) {
+    // The later groups that depend on this one are found when we regenerate,
+    // and only those are solved again; see GroupDependsOn().
+    SK.GetGroup(hg)->clean = false;
     unsaved = true;
     ScheduleGenerateAll();
 }
 
+// Set on the thread that's regenerating for display, while it is; only that
+// thread may look at the keyboard, not the solver's worker threads.
+static thread_local bool PollingForEscape = false;
+// Whether it was the Esc key, and not CancelGenerate(), that stopped it
+static bool StoppedByEscape = false;
+
+static void PollEscapeKey() {
+    if(!PollingForEscape || SS.generateCancelled) return;
+    if(EscapeKeyIsDown()) {
+        StoppedByEscape = true;
+        SS.CancelGenerate();
+    }
+}
+
+void SolveSpaceUI::CancelGenerate() {
+    generateCancelled = true;
+}
+
+bool SolveSpaceUI::EscapeStoppedGenerate() {
+    if(escapeStoppedGenerateAt == 0) return false;
+
+    // The keypresses that were queued come in as soon as we're back in the
+    // event loop, and if the key is still held, its repeats follow, each
+    // within the usual delay before a key repeats.
+    int64_t now = GetMilliseconds();
+    if(now - escapeStoppedGenerateAt > 750) {
+        escapeStoppedGenerateAt = 0;
+        return false;
+    }
+    escapeStoppedGenerateAt = now;
+    return true;
+}
+
+// A group's solid model, kept while it's made again, so that it can be put
+// back if that's stopped partway.
+struct SolidModel {
+    hGroup      h;
+    SShell      thisShell;
+    SShell      runningShell;
+    SMesh       thisMesh;
+    SMesh       runningMesh;
+    uint64_t    thisKey;
+    uint64_t    runningKey;
+    bool        booleanFailed;
+    bool        displayDirty;
+};
+
+static SolidModel TakeSolidModel(Group *g) {
+    SolidModel sm = {};
+    sm.h             = g->h;
+    sm.thisShell     = g->thisShell;
+    sm.runningShell  = g->runningShell;
+    sm.thisMesh      = g->thisMesh;
+    sm.runningMesh   = g->runningMesh;
+    sm.thisKey       = g->thisKey;
+    sm.runningKey    = g->runningKey;
+    sm.booleanFailed = g->booleanFailed;
+    sm.displayDirty  = g->displayDirty;
+    // The group's own lists now belong to sm, so start the group afresh.
+    g->thisShell     = {};
+    g->runningShell  = {};
+    g->thisMesh      = {};
+    g->runningMesh   = {};
+    return sm;
+}
+
+static void PutBackSolidModel(Group *g, SolidModel *sm) {
+    g->thisShell.Clear();
+    g->runningShell.Clear();
+    g->thisMesh.Clear();
+    g->runningMesh.Clear();
+    g->thisShell     = sm->thisShell;
+    g->runningShell  = sm->runningShell;
+    g->thisMesh      = sm->thisMesh;
+    g->runningMesh   = sm->runningMesh;
+    g->thisKey       = sm->thisKey;
+    g->runningKey    = sm->runningKey;
+    g->booleanFailed = sm->booleanFailed;
+    // The display items are made from the running shell and mesh only, so
+    // they're still good if they were before.
+    g->displayDirty  = sm->displayDirty;
+    *sm = {};
+}
+
+static void ClearSolidModel(SolidModel *sm) {
+    sm->thisShell.Clear();
+    sm->runningShell.Clear();
+    sm->thisMesh.Clear();
+    sm->runningMesh.Clear();
+}
+
 bool SolveSpaceUI::PruneOrphans() {
     int i;
+    std::vector<hRequest> requests;
     for(i = 0; i < SK.request.n; i++) {
         Request *r = &(SK.request.elem[i]);
         if(GroupExists(r->group)) continue;
 
         (deleted.requests)++;
-        SK.request.RemoveById(r->h);
-        return true;
+        requests.push_back(r->h);
     }
 
+    std::vector<hConstraint> constraints;
     for(i = 0; i < SK.constraint.n; i++) {
         Constraint *c = &(SK.constraint.elem[i]);
         if(GroupExists(c->group)) continue;
 
         (deleted.constraints)++;
         (deleted.nonTrivialConstraints)++;
-
-        SK.constraint.RemoveById(c->h);
-        return true;
+        constraints.push_back(c->h);
     }
-    return false;
+
+    SK.request.RemoveByIds(requests);
+    SK.constraint.RemoveByIds(constraints);
+    return !requests.empty() || !constraints.empty();
 }
 
 bool SolveSpaceUI::GroupsInOrder(hGroup before, hGroup after) {
@@ -90,8 +174,47 @@ bool SolveSpaceUI::PruneGroups(hGroup hg) {
     return true;
 }
 
+bool SolveSpaceUI::GroupDependsOn(Group *g, const std::unordered_set<uint32_t> &groups) {
+    if(groups.count(g->opA.v) || groups.count(g->opB.v)) return true;
+
+    auto dependsOn = [&](hEntity he) {
+        if(he.v == Entity::NO_ENTITY.v) return false;
+        Entity *e = SK.entity.FindByIdNoOops(he);
+        return e == NULL || groups.count(e->group.v) > 0;
+    };
+    if(dependsOn(g->predef.origin) ||
+       dependsOn(g->predef.entityB) ||
+       dependsOn(g->predef.entityC))
+    {
+        return true;
+    }
+
+    // A request's entities refer only to each other and its workplane, and
+    // the group's own entities only to those of its operands, so that's
+    // everything except for the constraints.
+    Sketch::GroupItems items = SK.ItemsInGroup(g->h);
+    for(int i : items.request) {
+        if(dependsOn(SK.request.elem[i].workplane)) return true;
+    }
+    for(int i : items.constraint) {
+        Constraint *c = &(SK.constraint.elem[i]);
+        if(dependsOn(c->workplane) ||
+           dependsOn(c->ptA) ||
+           dependsOn(c->ptB) ||
+           dependsOn(c->entityA) ||
+           dependsOn(c->entityB) ||
+           dependsOn(c->entityC) ||
+           dependsOn(c->entityD))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool SolveSpaceUI::PruneRequests(hGroup hg) {
     int i;
+    std::vector<hRequest> requests;
     for(i = 0; i < SK.entity.n; i++) {
         Entity *e = &(SK.entity.elem[i]);
         if(e->group.v != hg.v) continue;
@@ -100,18 +223,22 @@ bool SolveSpaceUI::PruneRequests(hGroup hg) {
 
         ssassert(e->h.isFromRequest(), "Only explicitly created entities can be pruned");
 
+        // A request's entities are next to each other, since their handles
+        // are made from the request's, so this is enough to count it once.
+        hRequest hr = e->h.request();
+        if(!requests.empty() && requests.back().v == hr.v) continue;
+
         (deleted.requests)++;
-        SK.request.RemoveById(e->h.request());
-        return true;
+        requests.push_back(hr);
     }
-    return false;
+    SK.request.RemoveByIds(requests);
+    return !requests.empty();
 }
 
 bool SolveSpaceUI::PruneConstraints(hGroup hg) {
-    int i;
-    for(i = 0; i < SK.constraint.n; i++) {
+    std::vector<hConstraint> constraints;
+    for(int i : SK.ItemsInGroup(hg).constraint) {
         Constraint *c = &(SK.constraint.elem[i]);
-        if(c->group.v != hg.v) continue;
 
         if(EntityExists(c->workplane) &&
            EntityExists(c->ptA) &&
@@ -132,13 +259,13 @@ bool SolveSpaceUI::PruneConstraints(hGroup hg) {
             (deleted.nonTrivialConstraints)++;
         }
 
-        SK.constraint.RemoveById(c->h);
-        return true;
+        constraints.push_back(c->h);
     }
-    return false;
+    SK.constraint.RemoveByIds(constraints);
+    return !constraints.empty();
 }
 
-void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox) {
+void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree) {
     int first = 0, last = 0, i, j;
 
     uint64_t startMillis = GetMilliseconds(),
@@ -200,30 +327,39 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         }
     }
 
-    // If we're generating entities for display, first we need to find
-    // the bounding box to turn relative chord tolerance to absolute.
-    if(!SS.exportMode && !genForBBox) {
-        GenerateAll(type, andFindFree, /*genForBBox=*/true);
-        BBox box = SK.CalculateEntityBBox(/*includeInvisibles=*/true);
-        Vector size = box.maxp.Minus(box.minp);
-        double maxSize = std::max({ size.x, size.y, size.z });
-        chordTolCalculated = maxSize * chordTol / 100.0;
+    // What the solver and the shell code check, to see whether they've been
+    // asked to stop. An export always goes through to the end.
+    CancelToken cancel = {};
+    if(!SS.exportMode) {
+        cancel.flag = &generateCancelled;
+        cancel.poll = &PollEscapeKey;
+        PollingForEscape = true;
     }
+    sys.cancel = cancel;
 
     // Remove any requests or constraints that refer to a nonexistent
     // group; can check those immediately, since we know what the list
     // of groups should be.
-    while(PruneOrphans())
-        ;
+    PruneOrphans();
 
     // Don't lose our numerical guesses when we regenerate.
-    IdList<Param,hParam> prev = {};
+    ParamList prev = {};
     SK.param.MoveSelfInto(&prev);
     SK.param.ReserveMore(prev.n);
     int oldEntityCount = SK.entity.n;
     SK.entity.Clear();
     SK.entity.ReserveMore(oldEntityCount);
 
+    // When we're regenerating only what's dirty, a clean group in the range
+    // is solved again only if it depends on a group that changed; and one
+    // after the range that does is left dirty for later.
+    bool onlyDependents = (type == Generate::DIRTY && first >= 0 && !SS.exportMode);
+    std::unordered_set<uint32_t> changed;
+    std::vector<bool> solved(SK.groupOrder.n, false);
+
+    // The requests and constraints don't change from here on, unless
+    // something is pruned, and then we start over.
+    SK.IndexItemsByGroup();
     for(i = 0; i < SK.groupOrder.n; i++) {
         Group *g = SK.GetGroup(SK.groupOrder.elem[i]);
 
@@ -233,17 +369,12 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         if(PruneGroups(g->h))
             goto pruned;
 
-        for(j = 0; j < SK.request.n; j++) {
-            Request *r = &(SK.request.elem[j]);
-            if(r->group.v != g->h.v) continue;
-
-            r->Generate(&(SK.entity), &(SK.param));
+        Sketch::GroupItems items = SK.ItemsInGroup(g->h);
+        for(int k : items.request) {
+            SK.request.elem[k].Generate(&(SK.entity), &(SK.param));
         }
-        for(j = 0; j < SK.constraint.n; j++) {
-            Constraint *c = &SK.constraint.elem[j];
-            if(c->group.v != g->h.v) continue;
-
-            c->Generate(&(SK.param));
+        for(int k : items.constraint) {
+            SK.constraint.elem[k].Generate(&(SK.param));
         }
         g->Generate(&(SK.entity), &(SK.param));
 
@@ -270,18 +401,40 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
             g->solved.how = SolveResult::OKAY;
             g->clean = true;
         } else {
-            if(i >= first && i <= last) {
+            bool inRange = (i >= first && i <= last);
+            if(onlyDependents && i >= first) {
+                if(!g->clean || (inRange && !g->IsSolvedOkay()) ||
+                   GroupDependsOn(g, changed))
+                {
+                    changed.insert(g->h.v);
+                    if(!inRange) g->clean = false;
+                } else {
+                    inRange = false;
+                }
+            }
+            if(inRange && cancel.Requested()) {
+                // We were asked to stop, so the group is left dirty, to be
+                // solved the next time that we regenerate.
+                g->clean = false;
+                inRange = false;
+            }
+
+            if(inRange) {
+                solved[i] = true;
                 // The group falls inside the range, so really solve it,
                 // and then regenerate the mesh based on the solved stuff.
-                if(genForBBox) {
+                // For display, the mesh waits until every group is solved;
+                // see below.
+                if(SS.exportMode) {
+                    g->GenerateShellAndMesh(cancel);
+                    g->clean = true;
+                } else {
                     SolveGroupAndReport(g->h, andFindFree);
                     g->GenerateLoops();
-                } else {
-                    g->GenerateShellAndMesh();
-                    g->clean = true;
                 }
             } else {
-                // The group falls outside the range, so just assume that
+                // The group falls outside the range, or nothing that it
+                // depends on has changed, so just assume that
                 // it's good wherever we left it. The mesh is unchanged,
                 // and the parameters must be marked as known.
                 for(j = 0; j < SK.param.n; j++) {
@@ -294,6 +447,76 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         }
     }
 
+    SK.ForgetItemsByGroup();
+
+    // If we're generating entities for display, the relative chord tolerance
+    // is turned to absolute using the bounding box of everything we just
+    // solved, and only then can the meshes be made.
+    if(!SS.exportMode) {
+        BBox box = SK.CalculateEntityBBox(/*includeInvisibles=*/true);
+        Vector size = box.maxp.Minus(box.minp);
+        double maxSize = std::max({ size.x, size.y, size.z });
+        double prevChordTol = chordTolCalculated;
+        chordTolCalculated = maxSize * chordTol / 100.0;
+
+        // Each group's running mesh is built on the one before, so once a
+        // group's solid model has changed, every later group's must be
+        // made again, even if it wasn't solved; as must all of them if the
+        // chord tolerance has changed.
+        bool runningChanged = !EXACT(chordTolCalculated == prevChordTol);
+        // The solid models are published all at once: if we're stopped
+        // partway, then every group gets back the one that it had, and the
+        // ones that we'd made are wasted, since they're all built on each
+        // other.
+        std::vector<SolidModel> before;
+        bool stopped = false;
+        for(i = 0; i < SK.groupOrder.n; i++) {
+            if(i < first || i > last) continue;
+            Group *g = SK.GetGroup(SK.groupOrder.elem[i]);
+            if(g->h.v == Group::HGROUP_REFERENCES.v) continue;
+            if(!solved[i] && !runningChanged) continue;
+            if(cancel.Requested()) {
+                stopped = true;
+                break;
+            }
+
+            bool hadSolid = !(g->thisShell.IsEmpty() && g->thisMesh.IsEmpty());
+            before.push_back(TakeSolidModel(g));
+            g->GenerateShellAndMesh(cancel);
+            if(cancel.Requested()) {
+                stopped = true;
+                break;
+            }
+            g->clean = true;
+            if(hadSolid || !(g->thisShell.IsEmpty() && g->thisMesh.IsEmpty())) {
+                runningChanged = true;
+            }
+        }
+        if(stopped) {
+            // So the groups are left dirty, with what they had, to be made
+            // again the next time that we regenerate; as are all the ones
+            // after, since they're built on them.
+            for(SolidModel &sm : before) {
+                PutBackSolidModel(SK.GetGroup(sm.h), &sm);
+            }
+            for(i = std::max(first, 0); i < SK.groupOrder.n; i++) {
+                Group *g = SK.GetGroup(SK.groupOrder.elem[i]);
+                if(g->h.v == Group::HGROUP_REFERENCES.v) continue;
+                g->clean = false;
+            }
+            nakedEdges.Clear();
+        } else {
+            for(SolidModel &sm : before) {
+                ClearSolidModel(&sm);
+            }
+        }
+        if(!stopped && runningChanged && onlyDependents) {
+            for(i = last + 1; i < SK.groupOrder.n; i++) {
+                SK.GetGroup(SK.groupOrder.elem[i])->clean = false;
+            }
+        }
+    }
+
     // And update any reference dimensions with their new values
     for(i = 0; i < SK.constraint.n; i++) {
         Constraint *c = &(SK.constraint.elem[i]);
@@ -356,6 +579,15 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
         deleted = {};
     }
 
+    PollingForEscape = false;
+    if(StoppedByEscape) {
+        escapeStoppedGenerateAt = GetMilliseconds();
+        StoppedByEscape = false;
+    }
+    // An export doesn't look at this, so a cancel waits for the next one
+    // that's for display.
+    if(!SS.exportMode) generateCancelled = false;
+
     FreeAllTemporary();
     allConsistent = true;
     SS.GW.persistentDirty = true;
@@ -372,20 +604,20 @@ void SolveSpaceUI::GenerateAll(Generate type, bool andFindFree, bool genForBBox)
             case Generate::UNTIL_ACTIVE:    typeStr = "UNTIL_ACTIVE"; break;
         }
         if(endMillis)
-        dbp("Generate::%s%s took %lld ms",
+        dbp("Generate::%s took %lld ms",
             typeStr,
-            (genForBBox ? " (for bounding box)" : ""),
             GetMilliseconds() - startMillis);
     }
 
     return;
 
 pruned:
+    SK.ForgetItemsByGroup();
     // Restore the numerical guesses
     SK.param.Clear();
     prev.MoveSelfInto(&(SK.param));
     // Try again
-    GenerateAll(type, andFindFree, genForBBox);
+    GenerateAll(type, andFindFree);
 }
 
 void SolveSpaceUI::ForceReferences() {
@@ -496,6 +728,9 @@ void SolveSpaceUI::SolveGroupAndReport(hGroup hg, bool andFindFree) {
     SolveGroup(hg, andFindFree);
 
     Group *g = SK.GetGroup(hg);
+    // We were asked to stop, so there's nothing wrong to report.
+    if(g->solved.how == SolveResult::CANCELLED) return;
+
     bool isOkay = g->solved.how == SolveResult::OKAY ||
                   (g->allowRedundant && g->solved.how == SolveResult::REDUNDANT_OKAY);
     if(!isOkay || (isOkay && !g->IsSolvedOkay())) {
@@ -510,17 +745,12 @@ void SolveSpaceUI::WriteEqSystemForGroup(hGroup hg) {
     sys.param.Clear();
     sys.eq.Clear();
     // And generate all the params for requests in this group
-    for(i = 0; i < SK.request.n; i++) {
-        Request *r = &(SK.request.elem[i]);
-        if(r->group.v != hg.v) continue;
-
-        r->Generate(&(sys.entity), &(sys.param));
+    Sketch::GroupItems items = SK.ItemsInGroup(hg);
+    for(int k : items.request) {
+        SK.request.elem[k].Generate(&(sys.entity), &(sys.param));
     }
-    for(i = 0; i < SK.constraint.n; i++) {
-        Constraint *c = &SK.constraint.elem[i];
-        if(c->group.v != hg.v) continue;
-
-        c->Generate(&(sys.param));
+    for(int k : items.constraint) {
+        SK.constraint.elem[k].Generate(&(sys.param));
     }
     // And for the group itself
     Group *g = SK.GetGroup(hg);
@@ -548,6 +778,7 @@ void SolveSpaceUI::SolveGroup(hGroup hg, bool andFindFree) {
         g->dofCheckOk = true;
     }
     g->solved.how = how;
+    g->solved.stats = sys.stats;
     FreeAllTemporary();
 }
 
@@ -777,6 +777,9 @@ Vector GraphicsWindow::SnapToGrid(Vector p) {
 void GraphicsWindow::MenuEdit(Command id) {
     switch(id) {
         case Command::UNSELECT_ALL:
+            // An Esc that stopped a slow regeneration was meant only for that.
+            if(SS.EscapeStoppedGenerate()) break;
+
             SS.GW.GroupSelection();
             // If there's nothing selected to de-select, and no operation
             // to cancel, then perhaps they want to return to the home
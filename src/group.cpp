@@ -25,6 +25,8 @@ void Group::Clear() {
     runningMesh.Clear();
     thisShell.Clear();
     runningShell.Clear();
+    thisKey = 0;
+    runningKey = 0;
     displayMesh.Clear();
     displayOutlines.Clear();
     impMesh.Clear();
@@ -34,7 +36,7 @@ void Group::Clear() {
     remap.Clear();
 }
 
-void Group::AddParam(IdList<Param,hParam> *param, hParam hp, double v) {
+void Group::AddParam(ParamList *param, hParam hp, double v) {
     Param pa = {};
     pa.h = hp;
     pa.val = v;
@@ -354,8 +356,8 @@ void Group::Activate() {
     SS.ScheduleShowTW();
 }
 
-void Group::Generate(IdList<Entity,hEntity> *entity,
-                     IdList<Param,hParam> *param)
+void Group::Generate(EntityList *entity,
+                     ParamList *param)
 {
     Vector gn = (SS.GW.projRight).Cross(SS.GW.projUp);
     Vector gp = SS.GW.projRight.Plus(SS.GW.projUp);
@@ -668,7 +670,7 @@ hEntity Group::Remap(hEntity in, int copyNumber) {
     return h.entity(em.h.v);
 }
 
-void Group::MakeExtrusionLines(IdList<Entity,hEntity> *el, hEntity in) {
+void Group::MakeExtrusionLines(EntityList *el, hEntity in) {
     Entity *ep = SK.GetEntity(in);
 
     Entity en = {};
@@ -704,7 +706,7 @@ void Group::MakeExtrusionLines(IdList<Entity,hEntity> *el, hEntity in) {
     }
 }
 
-void Group::MakeLatheCircles(IdList<Entity,hEntity> *el, IdList<Param,hParam> *param, hEntity in, Vector pt, Vector axis, int ai) {
+void Group::MakeLatheCircles(EntityList *el, ParamList *param, hEntity in, Vector pt, Vector axis, int ai) {
     Entity *ep = SK.GetEntity(in);
 
     Entity en = {};
@@ -776,7 +778,7 @@ void Group::MakeLatheCircles(IdList<Entity,hEntity> *el, IdList<Param,hParam> *p
     }
 }
 
-void Group::MakeExtrusionTopBottomFaces(IdList<Entity,hEntity> *el, hEntity pt)
+void Group::MakeExtrusionTopBottomFaces(EntityList *el, hEntity pt)
 {
     if(pt.v == 0) return;
     Group *src = SK.GetGroup(opA);
@@ -802,7 +804,7 @@ void Group::MakeExtrusionTopBottomFaces(IdList<Entity,hEntity> *el, hEntity pt)
     el->Add(&en);
 }
 
-void Group::CopyEntity(IdList<Entity,hEntity> *el,
+void Group::CopyEntity(EntityList *el,
                        Entity *ep, int timesApplied, int remap,
                        hParam dx, hParam dy, hParam dz,
                        hParam qw, hParam qvx, hParam qvy, hParam qvz,
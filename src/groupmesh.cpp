@@ -5,6 +5,7 @@
 //
 // Copyright 2008-2013 Jonathan Westhues.
 //-----------------------------------------------------------------------------
+#include <list>
 #include "solvespace.h"
 
 void Group::AssembleLoops(bool *allClosed,
@@ -103,7 +104,8 @@ void SMesh::RemapFaces(Group *g, int remap) {
 }
 
 template<class T>
-void Group::GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat) {
+void Group::GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat,
+                                     const CancelToken &cancel) {
     T workA, workB;
     workA = {};
     workB = {};
@@ -115,6 +117,8 @@ void Group::GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat
     }
     int a;
     for(a = a0; a < n; a++) {
+        if(cancel.Requested()) break;
+
         int ap = a*2 - (subtype == Subtype::ONE_SIDED ? 0 : (n-1));
         int remap = (a == (n - 1)) ? REMAP_LAST : a;
 
@@ -144,7 +148,7 @@ void Group::GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat
         } else if (forWhat == CombineAs::ASSEMBLE) {
             scratch->MakeFromAssemblyOf(soFar, &transd);
         } else {
-            scratch->MakeFromUnionOf(soFar, &transd);
+            scratch->MakeFromUnionOf(soFar, &transd, cancel);
         }
 
         swap(scratch, soFar);
@@ -157,7 +161,8 @@ void Group::GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat
 }
 
 template<class T>
-void Group::GenerateForBoolean(T *prevs, T *thiss, T *outs, Group::CombineAs how) {
+void Group::GenerateForBoolean(T *prevs, T *thiss, T *outs, Group::CombineAs how,
+                               const CancelToken &cancel) {
     // If this group contributes no new mesh, then our running mesh is the
     // same as last time, no combining required. Likewise if we have a mesh
     // but it's suppressed.
@@ -169,24 +174,244 @@ void Group::GenerateForBoolean(T *prevs, T *thiss, T *outs, Group::CombineAs how
     // So our group's shell appears in thisShell. Combine this with the
     // previous group's shell, using the requested operation.
     if(how == CombineAs::UNION) {
-        outs->MakeFromUnionOf(prevs, thiss);
+        outs->MakeFromUnionOf(prevs, thiss, cancel);
     } else if(how == CombineAs::DIFFERENCE) {
-        outs->MakeFromDifferenceOf(prevs, thiss);
+        outs->MakeFromDifferenceOf(prevs, thiss, cancel);
     } else {
         outs->MakeFromAssemblyOf(prevs, thiss);
     }
 }
 
-void Group::GenerateShellAndMesh() {
-    bool prevBooleanFailed = booleanFailed;
-    booleanFailed = false;
+//-----------------------------------------------------------------------------
+// A hash of shells, meshes, and the other things that they're made from. The
+// values are hashed exactly, bit for bit, since a cached result is only any
+// good if the same inputs would give exactly the same output.
+//-----------------------------------------------------------------------------
+namespace {
+class ShellHash {
+public:
+    uint64_t v;
+
+    ShellHash() : v(14695981039346656037ULL) {}
+
+    void Bytes(const void *p, size_t n) {
+        const uint8_t *b = (const uint8_t *)p;
+        for(size_t i = 0; i < n; i++) {
+            v = (v ^ b[i]) * 1099511628211ULL;
+        }
+    }
+    void Add(uint64_t x) { Bytes(&x, sizeof(x)); }
+    void Add(double x)   { Bytes(&x, sizeof(x)); }
+    void Add(Vector p)   { Add(p.x); Add(p.y); Add(p.z); }
+    void Add(RgbaColor c) {
+        Add((uint64_t)c.ToPackedInt());
+    }
 
+    void Add(const SBezier *sb) {
+        Add((uint64_t)sb->deg);
+        Add((uint64_t)sb->entity);
+        for(int i = 0; i <= sb->deg; i++) {
+            Add(sb->ctrl[i]);
+            Add(sb->weight[i]);
+        }
+    }
+
+    void Add(SShell *sh) {
+        Add((uint64_t)sh->booleanFailed);
+        for(SSurface *ss = sh->surface.First(); ss; ss = sh->surface.NextAfter(ss)) {
+            Add((uint64_t)ss->h.v);
+            Add(ss->color);
+            Add((uint64_t)ss->face);
+            Add((uint64_t)ss->degm);
+            Add((uint64_t)ss->degn);
+            for(int i = 0; i <= ss->degm; i++) {
+                for(int j = 0; j <= ss->degn; j++) {
+                    Add(ss->ctrl[i][j]);
+                    Add(ss->weight[i][j]);
+                }
+            }
+            for(STrimBy *stb = ss->trim.First(); stb; stb = ss->trim.NextAfter(stb)) {
+                Add((uint64_t)stb->curve.v);
+                Add((uint64_t)stb->backwards);
+                Add(stb->start);
+                Add(stb->finish);
+            }
+        }
+        for(SCurve *sc = sh->curve.First(); sc; sc = sh->curve.NextAfter(sc)) {
+            Add((uint64_t)sc->h.v);
+            Add((uint64_t)sc->source);
+            Add((uint64_t)sc->surfA.v);
+            Add((uint64_t)sc->surfB.v);
+            Add((uint64_t)sc->isExact);
+            if(sc->isExact) Add(&sc->exact);
+            for(SCurvePt *scp = sc->pts.First(); scp; scp = sc->pts.NextAfter(scp)) {
+                Add(scp->p);
+                Add((uint64_t)scp->vertex);
+            }
+        }
+    }
+
+    void Add(SMesh *m) {
+        for(STriangle *tr = m->l.First(); tr; tr = m->l.NextAfter(tr)) {
+            Add((uint64_t)tr->meta.face);
+            Add(tr->meta.color);
+            for(int i = 0; i < 3; i++) {
+                Add(tr->vertices[i]);
+                Add(tr->normals[i]);
+            }
+        }
+    }
+
+    // Zero is reserved to mean that the key isn't known.
+    uint64_t Key() const { return v ? v : 1; }
+};
+
+//-----------------------------------------------------------------------------
+// The results of the Boolean operations, by a hash of their inputs; so when
+// the same model is regenerated again (after an undo, or after suppressing
+// a group and then unsuppressing it), the Booleans don't have to be redone.
+// The least recently used results are dropped to stay within a fixed amount
+// of memory. This is only ever used from the main thread.
+//-----------------------------------------------------------------------------
+class ShellCache {
+public:
+    struct Entry {
+        uint64_t    key;
+        SShell      shell;
+        SMesh       mesh;
+        SEdgeList   nakedEdges;
+        size_t      size;
+    };
+    static const size_t MAX_SIZE = 256*1024*1024;
+
+    // Most recently used first.
+    std::list<Entry>                                         entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> byKey;
+    size_t                                                   size;
+
+    ShellCache() : size(0) {}
+
+    static size_t SizeOf(SShell *sh, SMesh *m, SEdgeList *el) {
+        size_t n = sizeof(Entry);
+        for(SSurface *ss = sh->surface.First(); ss; ss = sh->surface.NextAfter(ss)) {
+            n += sizeof(SSurface) + ss->trim.n*sizeof(STrimBy);
+        }
+        for(SCurve *sc = sh->curve.First(); sc; sc = sh->curve.NextAfter(sc)) {
+            n += sizeof(SCurve) + sc->pts.n*sizeof(SCurvePt);
+        }
+        n += m->l.n*sizeof(STriangle) + el->l.n*sizeof(SEdge);
+        return n;
+    }
+
+    // Copies a cached result in to the shell and mesh, and adds back any
+    // naked edges found while making it; or returns false if there's none.
+    bool Find(uint64_t key, SShell *sh, SMesh *m) {
+        auto it = byKey.find(key);
+        if(it == byKey.end()) return false;
+        entries.splice(entries.begin(), entries, it->second);
+
+        Entry *e = &(*it->second);
+        sh->MakeFromCopyOf(&e->shell);
+        sh->booleanFailed = e->shell.booleanFailed;
+        m->MakeFromCopyOf(&e->mesh);
+        for(SEdge *se = e->nakedEdges.l.First(); se; se = e->nakedEdges.l.NextAfter(se)) {
+            SS.nakedEdges.AddEdge(se->a, se->b);
+        }
+        return true;
+    }
+
+    // The naked edges found while making it are those in the list from the
+    // given index on.
+    void Add(uint64_t key, SShell *sh, SMesh *m,
+             SEdgeList *nakedEdges, int nakedEdgesFrom) {
+        if(byKey.find(key) != byKey.end()) return;
+
+        entries.emplace_front();
+        Entry *e = &entries.front();
+        e->key = key;
+        e->shell = {};
+        e->shell.MakeFromCopyOf(sh);
+        e->shell.booleanFailed = sh->booleanFailed;
+        e->mesh = {};
+        e->mesh.MakeFromCopyOf(m);
+        e->nakedEdges = {};
+        for(int i = nakedEdgesFrom; i < nakedEdges->l.n; i++) {
+            SEdge *se = &nakedEdges->l.elem[i];
+            e->nakedEdges.AddEdge(se->a, se->b);
+        }
+        e->size = SizeOf(&e->shell, &e->mesh, &e->nakedEdges);
+        byKey[key] = entries.begin();
+        size += e->size;
+
+        // Always keep the one just added, even if it's too big by itself.
+        while(size > MAX_SIZE && entries.size() > 1) {
+            DropLast();
+        }
+    }
+
+    void DropLast() {
+        Entry *last = &entries.back();
+        size -= last->size;
+        byKey.erase(last->key);
+        last->shell.Clear();
+        last->mesh.Clear();
+        last->nakedEdges.Clear();
+        entries.pop_back();
+    }
+
+    void Clear() {
+        while(!entries.empty()) DropLast();
+    }
+};
+
+// Never destroyed, like the worker pool; the process is about to exit anyway.
+ShellCache *Cache = new ShellCache();
+}
+
+// In two halves, the group's own shell and then its Boolean with the running
+// shell before it, since each is keyed in the cache separately: an unchanged
+// own shell lets the Boolean be found again even when other groups changed.
+void Group::GenerateShellAndMesh(const CancelToken &cancel) {
+    GenerateThisShellAndMesh(cancel);
+    if(cancel.Requested()) return;
+    GenerateRunningShellAndMesh(cancel);
+}
+
+uint64_t Group::StepAndRepeatKey() {
+    Group *srcg = SK.GetGroup(opA);
+    if(srcg->thisKey == 0) return 0;
+
+    ShellHash hash;
+    hash.Add((uint64_t)type);
+    hash.Add((uint64_t)subtype);
+    hash.Add((uint64_t)skipFirst);
+    hash.Add(valA);
+    for(int i = 0; i < 7; i++) {
+        Param *p = SK.param.FindByIdNoOops(h.param(i));
+        if(p) hash.Add(p->val);
+    }
+    hash.Add(srcg->thisKey);
+    hash.Add((uint64_t)srcg->suppress);
+    hash.Add((uint64_t)srcg->meshCombine);
+    hash.Add((uint64_t)IsForcedToMesh());
+    // The copies' faces are renamed through our remap table.
+    hash.Add((uint64_t)h.v);
+    for(EntityMap *em = remap.First(); em; em = remap.NextAfter(em)) {
+        hash.Add((uint64_t)em->h.v);
+        hash.Add((uint64_t)em->input.v);
+        hash.Add((uint64_t)em->copyNumber);
+    }
+    hash.Add(SS.ChordTolMm());
+    hash.Add((uint64_t)SS.GetMaxSegments());
+    return hash.Key();
+}
+
+void Group::GenerateThisShellAndMesh(const CancelToken &cancel) {
     Group *srcg = this;
 
     thisShell.Clear();
     thisMesh.Clear();
-    runningShell.Clear();
-    runningMesh.Clear();
+    thisKey = 0;
 
     // Don't attempt a lathe or extrusion unless the source section is good:
     // planar and not self-intersecting.
@@ -203,16 +428,46 @@ void Group::GenerateShellAndMesh() {
         // not our own previous group.
         srcg = SK.GetGroup(opA);
 
+        // That's a union of many copies, so look for it in the cache first.
+        uint64_t key = StepAndRepeatKey();
+        if(key != 0 && Cache->Find(key, &thisShell, &thisMesh)) {
+            thisKey = key;
+            return;
+        }
+
+        int remapBefore = remap.n;
+        int nakedEdgesBefore = SS.nakedEdges.l.n;
         if(!srcg->suppress) {
             if(!IsForcedToMesh()) {
-                GenerateForStepAndRepeat<SShell>(&(srcg->thisShell), &thisShell, srcg->meshCombine);
+                GenerateForStepAndRepeat<SShell>(&(srcg->thisShell), &thisShell,
+                                                 srcg->meshCombine, cancel);
             } else {
                 SMesh prevm = {};
                 prevm.MakeFromCopyOf(&srcg->thisMesh);
-                srcg->thisShell.TriangulateInto(&prevm);
-                GenerateForStepAndRepeat<SMesh> (&prevm, &thisMesh, srcg->meshCombine);
+                srcg->thisShell.TriangulateInto(&prevm, cancel);
+                GenerateForStepAndRepeat<SMesh> (&prevm, &thisMesh,
+                                                 srcg->meshCombine, cancel);
             }
         }
+        // If we were asked to stop partway, then this isn't worth keeping;
+        // the caller puts back what we had before.
+        if(cancel.Requested()) return;
+        if(srcg->meshCombine != CombineAs::ASSEMBLE) {
+            thisShell.MergeCoincidentSurfaces();
+        }
+
+        // If any faces were given new names, then that can't be replayed
+        // from the cache, so the result isn't kept.
+        if(key != 0 && remap.n == remapBefore) {
+            Cache->Add(key, &thisShell, &thisMesh, &SS.nakedEdges, nakedEdgesBefore);
+            thisKey = key;
+        } else {
+            ShellHash hash;
+            hash.Add(&thisShell);
+            hash.Add(&thisMesh);
+            thisKey = hash.Key();
+        }
+        return;
     } else if(type == Type::EXTRUDE && haveSrc) {
         Group *src = SK.GetGroup(opA);
         Vector translate = Vector::From(h.param(0), h.param(1), h.param(2));
@@ -317,20 +572,71 @@ void Group::GenerateShellAndMesh() {
         thisShell.MergeCoincidentSurfaces();
     }
 
+    // Cheap to make again, so just key the result by what's in it.
+    ShellHash hash;
+    hash.Add(&thisShell);
+    hash.Add(&thisMesh);
+    thisKey = hash.Key();
+}
+
+void Group::GenerateRunningShellAndMesh(const CancelToken &cancel) {
+    bool prevBooleanFailed = booleanFailed;
+    booleanFailed = false;
+
+    runningShell.Clear();
+    runningMesh.Clear();
+    runningKey = 0;
+
     // So now we've got the mesh or shell for this group. Combine it with
     // the previous group's mesh or shell with the requested Boolean, and
     // we're done.
 
+    Group *srcg = this;
+    if(type == Type::TRANSLATE || type == Type::ROTATE) {
+        srcg = SK.GetGroup(opA);
+    }
     Group *prevg = srcg->RunningMeshGroup();
 
-    if(!IsForcedToMesh()) {
-        SShell *prevs = &(prevg->runningShell);
-        GenerateForBoolean<SShell>(prevs, &thisShell, &runningShell,
-            srcg->meshCombine);
+    // The result is determined by the two operands and how they're
+    // combined, so if we've done this Boolean before, it's in the cache.
+    uint64_t prevKey = prevg->runningKey;
+    if(prevKey == 0 && prevg->runningShell.IsEmpty() && prevg->runningMesh.IsEmpty()) {
+        ShellHash empty;
+        prevKey = empty.Key();
+    }
+    uint64_t key = 0;
+    if(prevKey != 0 && thisKey != 0) {
+        ShellHash hash;
+        hash.Add(prevKey);
+        hash.Add(thisKey);
+        hash.Add((uint64_t)srcg->meshCombine);
+        hash.Add((uint64_t)suppress);
+        hash.Add((uint64_t)IsForcedToMesh());
+        hash.Add(SS.ChordTolMm());
+        hash.Add((uint64_t)SS.GetMaxSegments());
+        key = hash.Key();
+    }
+    int nakedEdgesBefore = SS.nakedEdges.l.n;
 
-        if(srcg->meshCombine != CombineAs::ASSEMBLE) {
-            runningShell.MergeCoincidentSurfaces();
+    if(!IsForcedToMesh()) {
+        // Nothing to gain from caching a plain copy of the previous shell.
+        bool trivial = (thisShell.IsEmpty() || suppress);
+        bool cached = (key != 0 && !trivial &&
+                       Cache->Find(key, &runningShell, &runningMesh));
+        if(!cached) {
+            SShell *prevs = &(prevg->runningShell);
+            GenerateForBoolean<SShell>(prevs, &thisShell, &runningShell,
+                srcg->meshCombine, cancel);
+            if(cancel.Requested()) return;
+
+            if(srcg->meshCombine != CombineAs::ASSEMBLE) {
+                runningShell.MergeCoincidentSurfaces();
+            }
+            if(key != 0 && !trivial) {
+                Cache->Add(key, &runningShell, &runningMesh, &SS.nakedEdges, nakedEdgesBefore);
+            }
         }
+        runningKey = key;
 
         // If the Boolean failed, then we should note that in the text screen
         // for this group.
@@ -338,19 +644,21 @@ void Group::GenerateShellAndMesh() {
         if(booleanFailed != prevBooleanFailed) {
             SS.ScheduleShowTW();
         }
+    } else if(key != 0 && Cache->Find(key, &runningShell, &runningMesh)) {
+        runningKey = key;
     } else {
         SMesh prevm, thism;
         prevm = {};
         thism = {};
 
         prevm.MakeFromCopyOf(&(prevg->runningMesh));
-        prevg->runningShell.TriangulateInto(&prevm);
+        prevg->runningShell.TriangulateInto(&prevm, cancel);
 
         thism.MakeFromCopyOf(&thisMesh);
-        thisShell.TriangulateInto(&thism);
+        thisShell.TriangulateInto(&thism, cancel);
 
         SMesh outm = {};
-        GenerateForBoolean<SMesh>(&prevm, &thism, &outm, srcg->meshCombine);
+        GenerateForBoolean<SMesh>(&prevm, &thism, &outm, srcg->meshCombine, cancel);
 
         // Remove degenerate triangles; if we don't, they'll get split in SnapToMesh
         // in every generated group, resulting in polynomial increase in triangle count,
@@ -365,6 +673,13 @@ void Group::GenerateShellAndMesh() {
         outm.Clear();
         thism.Clear();
         prevm.Clear();
+
+        // The triangulations may have stopped partway.
+        if(cancel.Requested()) return;
+        if(key != 0) {
+            Cache->Add(key, &runningShell, &runningMesh, &SS.nakedEdges, nakedEdgesBefore);
+        }
+        runningKey = key;
     }
 
     displayDirty = true;
@@ -712,3 +1027,297 @@ void Group::DrawContourAreaLabels(Canvas *canvas) {
     }
 }
 
+
+//-----------------------------------------------------------------------------
+// The cached Boolean results for a sketch can also be kept in a file beside
+// it, so that if the sketch hasn't changed since, it opens without redoing
+// them. The file is binary and only meant to be read back on the same kind
+// of machine; it's ignored unless it was written for exactly the sketch file
+// that's being opened, and by the same version of the geometry code.
+//-----------------------------------------------------------------------------
+namespace {
+const char     REGEN_CACHE_MAGIC[]  = "SolveSpaceREGENCACHE";
+// Bump this whenever a change to the geometry code could make a different
+// shell or mesh from the same inputs, so that older caches are ignored.
+const uint32_t REGEN_CACHE_VERSION  = 1;
+const uint32_t REGEN_CACHE_BYTE_ORDER = 0x01020304;
+
+uint64_t HashOfFile(const Platform::Path &filename, bool *ok) {
+    std::string data;
+    *ok = ReadFile(filename, &data);
+    ShellHash hash;
+    hash.Bytes(data.data(), data.size());
+    return hash.Key();
+}
+
+class CacheWriter {
+public:
+    std::string data;
+
+    template<class T> void Put(T v) { data.append((const char *)&v, sizeof(v)); }
+    void Put(Vector p) { Put(p.x); Put(p.y); Put(p.z); }
+
+    void Put(SShell *sh) {
+        Put((uint8_t)sh->booleanFailed);
+        Put((uint32_t)sh->surface.n);
+        for(SSurface *ss = sh->surface.First(); ss; ss = sh->surface.NextAfter(ss)) {
+            Put(ss->h.v);
+            Put(ss->color.ToPackedInt());
+            Put(ss->face);
+            Put((int32_t)ss->degm);
+            Put((int32_t)ss->degn);
+            for(int i = 0; i <= ss->degm; i++) {
+                for(int j = 0; j <= ss->degn; j++) {
+                    Put(ss->ctrl[i][j]);
+                    Put(ss->weight[i][j]);
+                }
+            }
+            Put((uint32_t)ss->trim.n);
+            for(STrimBy *stb = ss->trim.First(); stb; stb = ss->trim.NextAfter(stb)) {
+                Put(stb->curve.v);
+                Put((uint8_t)stb->backwards);
+                Put(stb->start);
+                Put(stb->finish);
+            }
+        }
+        Put((uint32_t)sh->curve.n);
+        for(SCurve *sc = sh->curve.First(); sc; sc = sh->curve.NextAfter(sc)) {
+            Put(sc->h.v);
+            Put((uint32_t)sc->source);
+            Put(sc->surfA.v);
+            Put(sc->surfB.v);
+            Put((uint8_t)sc->isExact);
+            Put((int32_t)sc->exact.deg);
+            Put(sc->exact.entity);
+            for(int i = 0; i < 4; i++) {
+                Put(sc->exact.ctrl[i]);
+                Put(sc->exact.weight[i]);
+            }
+            Put((uint32_t)sc->pts.n);
+            for(SCurvePt *scp = sc->pts.First(); scp; scp = sc->pts.NextAfter(scp)) {
+                Put(scp->p);
+                Put((uint8_t)scp->vertex);
+            }
+        }
+    }
+
+    void Put(SMesh *m) {
+        Put((uint32_t)m->l.n);
+        for(STriangle *tr = m->l.First(); tr; tr = m->l.NextAfter(tr)) {
+            Put(tr->meta.face);
+            Put(tr->meta.color.ToPackedInt());
+            for(int i = 0; i < 3; i++) {
+                Put(tr->vertices[i]);
+                Put(tr->normals[i]);
+            }
+        }
+    }
+
+    void Put(SEdgeList *el) {
+        Put((uint32_t)el->l.n);
+        for(SEdge *se = el->l.First(); se; se = el->l.NextAfter(se)) {
+            Put(se->a);
+            Put(se->b);
+        }
+    }
+};
+
+class CacheReader {
+public:
+    const std::string &data;
+    size_t             pos;
+    bool               ok;
+
+    CacheReader(const std::string &data) : data(data), pos(0), ok(true) {}
+
+    template<class T> T Get() {
+        T v = {};
+        if(!ok || data.size() - pos < sizeof(v)) {
+            ok = false;
+            return v;
+        }
+        memcpy(&v, data.data() + pos, sizeof(v));
+        pos += sizeof(v);
+        return v;
+    }
+    Vector GetVector() {
+        double x = Get<double>(), y = Get<double>(), z = Get<double>();
+        return Vector::From(x, y, z);
+    }
+    // A count of items, each at least the given size; checked against what's
+    // left, so that a damaged file can't make us allocate without bound.
+    uint32_t GetCount(size_t itemSize) {
+        uint32_t n = Get<uint32_t>();
+        if(ok && n > (data.size() - pos) / itemSize) ok = false;
+        return ok ? n : 0;
+    }
+
+    void Get(SShell *sh) {
+        sh->booleanFailed = (Get<uint8_t>() != 0);
+        uint32_t ns = GetCount(4);
+        for(uint32_t i = 0; ok && i < ns; i++) {
+            SSurface ss = {};
+            ss.h.v   = Get<uint32_t>();
+            ss.color = RgbaColor::FromPackedInt(Get<uint32_t>());
+            ss.face  = Get<uint32_t>();
+            ss.degm  = Get<int32_t>();
+            ss.degn  = Get<int32_t>();
+            if(ss.degm < 0 || ss.degm > 3 || ss.degn < 0 || ss.degn > 3) {
+                ok = false;
+                break;
+            }
+            for(int m = 0; m <= ss.degm; m++) {
+                for(int n = 0; n <= ss.degn; n++) {
+                    ss.ctrl[m][n]   = GetVector();
+                    ss.weight[m][n] = Get<double>();
+                }
+            }
+            uint32_t nt = GetCount(4);
+            for(uint32_t j = 0; ok && j < nt; j++) {
+                STrimBy stb = {};
+                stb.curve.v   = Get<uint32_t>();
+                stb.backwards = (Get<uint8_t>() != 0);
+                stb.start     = GetVector();
+                stb.finish    = GetVector();
+                ss.trim.Add(&stb);
+            }
+            if(!ok || sh->surface.FindByIdNoOops(ss.h)) {
+                ok = false;
+                ss.Clear();
+                break;
+            }
+            sh->surface.Add(&ss);
+        }
+        uint32_t nc = GetCount(4);
+        for(uint32_t i = 0; ok && i < nc; i++) {
+            SCurve sc = {};
+            sc.h.v     = Get<uint32_t>();
+            sc.source  = (SCurve::Source)Get<uint32_t>();
+            sc.surfA.v = Get<uint32_t>();
+            sc.surfB.v = Get<uint32_t>();
+            sc.isExact = (Get<uint8_t>() != 0);
+            sc.exact.deg    = Get<int32_t>();
+            sc.exact.entity = Get<uint32_t>();
+            for(int j = 0; j < 4; j++) {
+                sc.exact.ctrl[j]   = GetVector();
+                sc.exact.weight[j] = Get<double>();
+            }
+            uint32_t np = GetCount(1);
+            for(uint32_t j = 0; ok && j < np; j++) {
+                SCurvePt scp = {};
+                scp.p      = GetVector();
+                scp.vertex = (Get<uint8_t>() != 0);
+                sc.pts.Add(&scp);
+            }
+            if(!ok || sc.exact.deg < 0 || sc.exact.deg > 3 ||
+               sh->curve.FindByIdNoOops(sc.h)) {
+                ok = false;
+                sc.Clear();
+                break;
+            }
+            sh->curve.Add(&sc);
+        }
+    }
+
+    void Get(SMesh *m) {
+        uint32_t n = GetCount(4);
+        for(uint32_t i = 0; ok && i < n; i++) {
+            STriangle tr = {};
+            tr.meta.face  = Get<uint32_t>();
+            tr.meta.color = RgbaColor::FromPackedInt(Get<uint32_t>());
+            for(int j = 0; j < 3; j++) {
+                tr.vertices[j] = GetVector();
+                tr.normals[j]  = GetVector();
+            }
+            m->AddTriangle(&tr);
+        }
+    }
+
+    void Get(SEdgeList *el) {
+        uint32_t n = GetCount(4);
+        for(uint32_t i = 0; ok && i < n; i++) {
+            Vector a = GetVector(), b = GetVector();
+            el->AddEdge(a, b);
+        }
+    }
+};
+}
+
+Platform::Path SolveSpaceUI::RegenCacheFor(const Platform::Path &filename) {
+    return filename.WithExtension(REGEN_CACHE_EXT);
+}
+
+void SolveSpaceUI::SaveRegenCache(const Platform::Path &filename) {
+    bool ok;
+    uint64_t fileHash = HashOfFile(filename, &ok);
+    if(!ok) return;
+
+    // Only what the sketch uses right now; not whatever else happens to
+    // be in the cache, from undone changes or other sketches.
+    std::vector<std::list<ShellCache::Entry>::iterator> used;
+    std::unordered_set<uint64_t> seen;
+    for(int i = 0; i < SK.groupOrder.n; i++) {
+        Group *g = SK.GetGroup(SK.groupOrder.elem[i]);
+        for(uint64_t key : { g->thisKey, g->runningKey }) {
+            auto it = Cache->byKey.find(key);
+            if(it == Cache->byKey.end() || !seen.insert(key).second) continue;
+            used.push_back(it->second);
+        }
+    }
+
+    CacheWriter w;
+    w.data.append(REGEN_CACHE_MAGIC, sizeof(REGEN_CACHE_MAGIC));
+    w.Put(REGEN_CACHE_VERSION);
+    w.Put(REGEN_CACHE_BYTE_ORDER);
+    w.Put(fileHash);
+    w.Put((uint32_t)used.size());
+    for(auto &it : used) {
+        w.Put(it->key);
+        w.Put(&it->shell);
+        w.Put(&it->mesh);
+        w.Put(&it->nakedEdges);
+    }
+
+    if(!WriteFile(RegenCacheFor(filename), w.data)) {
+        dbp("couldn't write regeneration cache for '%s'", filename.raw.c_str());
+    }
+}
+
+bool SolveSpaceUI::LoadRegenCache(const Platform::Path &filename) {
+    std::string data;
+    if(!ReadFile(RegenCacheFor(filename), &data)) return false;
+
+    bool ok;
+    uint64_t fileHash = HashOfFile(filename, &ok);
+    if(!ok) return false;
+
+    CacheReader r(data);
+    if(data.size() < sizeof(REGEN_CACHE_MAGIC) ||
+       memcmp(data.data(), REGEN_CACHE_MAGIC, sizeof(REGEN_CACHE_MAGIC)) != 0) {
+        return false;
+    }
+    r.pos = sizeof(REGEN_CACHE_MAGIC);
+    if(r.Get<uint32_t>() != REGEN_CACHE_VERSION)    return false;
+    if(r.Get<uint32_t>() != REGEN_CACHE_BYTE_ORDER) return false;
+    if(r.Get<uint64_t>() != fileHash)               return false;
+
+    uint32_t n = r.GetCount(8);
+    for(uint32_t i = 0; r.ok && i < n; i++) {
+        uint64_t key = r.Get<uint64_t>();
+        SShell sh = {};
+        SMesh m = {};
+        SEdgeList el = {};
+        r.Get(&sh);
+        r.Get(&m);
+        r.Get(&el);
+        if(r.ok) Cache->Add(key, &sh, &m, &el, 0);
+        sh.Clear();
+        m.Clear();
+        el.Clear();
+    }
+    return r.ok;
+}
+
+void SolveSpaceUI::ForgetCachedShells() {
+    Cache->Clear();
+}
@@ -7,11 +7,34 @@
 #include "solvespace.h"
 #define EXPORT_DLL
 #include <slvs.h>
+#include <mutex>
 
-Sketch SolveSpace::SK = {};
-static System SYS;
+thread_local Sketch SolveSpace::SK = {};
 
-static int IsInit = 0;
+// Everything that the solver keeps from one call to the next.
+struct Slvs_Context {
+    System              sys;
+    // Set by Slvs_CancelContext(), and cleared by the solve that stops for it
+    std::atomic<bool>   cancel;
+
+    Slvs_Context() : sys(), cancel(false) {
+        sys.cancel.flag = &cancel;
+    }
+    ~Slvs_Context() {
+        sys.Clear();
+    }
+};
+
+// The context for Slvs_Solve() and Slvs_SolveBatch(), one per thread.
+static Slvs_Context *ThreadContext() {
+    static thread_local Slvs_Context ctx;
+    return &ctx;
+}
+
+static void InitLibrary() {
+    static std::once_flag initialized;
+    std::call_once(initialized, [] { InitPlatform(0, NULL); });
+}
 
 void Group::GenerateEquations(IdList<Equation,hEquation> *) {
     // Nothing to do for now.
@@ -38,68 +61,27 @@ void SolveSpace::SplashBox(const char *, int, int)
     abort();
 }
 
-extern "C" {
-
-void Slvs_QuaternionU(double qw, double qx, double qy, double qz,
-                         double *x, double *y, double *z)
-{
-    Quaternion q = Quaternion::From(qw, qx, qy, qz);
-    Vector v = q.RotationU();
-    *x = v.x;
-    *y = v.y;
-    *z = v.z;
-}
-
-void Slvs_QuaternionV(double qw, double qx, double qy, double qz,
-                         double *x, double *y, double *z)
-{
-    Quaternion q = Quaternion::From(qw, qx, qy, qz);
-    Vector v = q.RotationV();
-    *x = v.x;
-    *y = v.y;
-    *z = v.z;
-}
-
-void Slvs_QuaternionN(double qw, double qx, double qy, double qz,
-                         double *x, double *y, double *z)
-{
-    Quaternion q = Quaternion::From(qw, qx, qy, qz);
-    Vector v = q.RotationN();
-    *x = v.x;
-    *y = v.y;
-    *z = v.z;
-}
-
-void Slvs_MakeQuaternion(double ux, double uy, double uz,
-                         double vx, double vy, double vz,
-                         double *qw, double *qx, double *qy, double *qz)
-{
-    Vector u = Vector::From(ux, uy, uz),
-           v = Vector::From(vx, vy, vz);
-    Quaternion q = Quaternion::From(u, v);
-    *qw = q.w;
-    *qx = q.vx;
-    *qy = q.vy;
-    *qz = q.vz;
-}
-
-void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
+//-----------------------------------------------------------------------------
+// Write the caller's system in to our sketch, and its unknowns in group shg in
+// to sys; with the params' values from val[], if given, and otherwise from the
+// system itself. Returns false if there's anything that we don't recognize.
+//-----------------------------------------------------------------------------
+static bool WriteSketch(System *sys, Slvs_System *ssys, Slvs_hGroup shg,
+                        const double *val)
 {
-    if(!IsInit) {
-        InitPlatform(0, NULL);
-        IsInit = 1;
-    }
-
     int i;
     for(i = 0; i < ssys->params; i++) {
         Slvs_Param *sp = &(ssys->param[i]);
         Param p = {};
 
         p.h.v = sp->h;
-        p.val = sp->val;
-        SK.param.Add(&p);
+        p.val = val ? val[i] : sp->val;
+        // Params from other groups are fixed, same as earlier groups in the
+        // sketch are once they're solved.
+        p.known = (sp->group != shg);
+        SK.param.AddUnsorted(&p);
         if(sp->group == shg) {
-            SYS.param.Add(&p);
+            sys->param.AddUnsorted(&p);
         }
     }
 
@@ -119,7 +101,7 @@ case SLVS_E_CUBIC:              e.type = Entity::Type::CUBIC; break;
 case SLVS_E_CIRCLE:             e.type = Entity::Type::CIRCLE; break;
 case SLVS_E_ARC_OF_CIRCLE:      e.type = Entity::Type::ARC_OF_CIRCLE; break;
 
-default: dbp("bad entity type %d", se->type); return;
+default: dbp("bad entity type %d", se->type); return false;
         }
         e.h.v           = se->h;
         e.group.v       = se->group;
@@ -135,9 +117,14 @@ default: dbp("bad entity type %d", se->type); return;
         e.param[2].v    = se->param[2];
         e.param[3].v    = se->param[3];
 
-        SK.entity.Add(&e);
+        SK.entity.AddUnsorted(&e);
     }
-    IdList<Param, hParam> params = {};
+    // The caller's handles may come in any order, so sort them all at once.
+    SK.param.SortById();
+    sys->param.SortById();
+    SK.entity.SortById();
+
+    ParamList params = {};
     for(i = 0; i < ssys->constraints; i++) {
         Slvs_Constraint *sc = &(ssys->constraint[i]);
         ConstraintBase c = {};
@@ -179,7 +166,7 @@ case SLVS_C_PROJ_PT_DISTANCE:   t = Constraint::Type::PROJ_PT_DISTANCE; break;
 case SLVS_C_WHERE_DRAGGED:      t = Constraint::Type::WHERE_DRAGGED; break;
 case SLVS_C_CURVE_CURVE_TANGENT:t = Constraint::Type::CURVE_CURVE_TANGENT; break;
 
-default: dbp("bad constraint type %d", sc->type); return;
+default: dbp("bad constraint type %d", sc->type); return false;
         }
 
         c.type = t;
@@ -202,52 +189,156 @@ default: dbp("bad constraint type %d", sc->type); return;
             for(Param &p : params) {
                 p.h = SK.param.AddAndAssignId(&p);
                 c.valP = p.h;
-                SYS.param.Add(&p);
+                sys->param.Add(&p);
             }
             params.Clear();
             c.ModifyToSatisfy();
         }
 
-        SK.constraint.Add(&c);
+        SK.constraint.AddUnsorted(&c);
     }
+    SK.constraint.SortById();
 
     for(i = 0; i < (int)arraylen(ssys->dragged); i++) {
         if(ssys->dragged[i]) {
             hParam hp = { ssys->dragged[i] };
-            SYS.dragged.Add(&hp);
+            sys->dragged.Add(&hp);
         }
     }
+    return true;
+}
 
-    Group g = {};
-    g.h.v = shg;
-
-    List<hConstraint> bad = {};
-
-    // Now we're finally ready to solve!
-    bool andFindBad = ssys->calculateFaileds ? true : false;
-    SolveResult how = SYS.Solve(&g, &(ssys->dof), &bad, andFindBad, /*andFindFree=*/false);
-
+static int ResultFor(SolveResult how) {
     switch(how) {
         case SolveResult::OKAY:
-            ssys->result = SLVS_RESULT_OKAY;
-            break;
+            return SLVS_RESULT_OKAY;
 
         case SolveResult::DIDNT_CONVERGE:
-            ssys->result = SLVS_RESULT_DIDNT_CONVERGE;
-            break;
+            return SLVS_RESULT_DIDNT_CONVERGE;
 
         case SolveResult::REDUNDANT_DIDNT_CONVERGE:
         case SolveResult::REDUNDANT_OKAY:
-            ssys->result = SLVS_RESULT_INCONSISTENT;
-            break;
+            return SLVS_RESULT_INCONSISTENT;
 
         case SolveResult::TOO_MANY_UNKNOWNS:
-            ssys->result = SLVS_RESULT_TOO_MANY_UNKNOWNS;
-            break;
+            return SLVS_RESULT_TOO_MANY_UNKNOWNS;
+
+        case SolveResult::CANCELLED:
+            return SLVS_RESULT_CANCELLED;
+    }
+    ssassert(false, "Unexpected solve result");
+}
+
+static void ClearSketch(System *sys) {
+    sys->param.Clear();
+    sys->entity.Clear();
+    sys->eq.Clear();
+    sys->dragged.Clear();
+
+    SK.param.Clear();
+    SK.entity.Clear();
+    SK.constraint.Clear();
+
+    FreeAllTemporary();
+}
+
+// Copy the values of the caller's params out of a param table.
+static void ReadParams(Slvs_System *ssys, ParamList *from, double *val) {
+    for(int i = 0; i < ssys->params; i++) {
+        hParam hp = { ssys->param[i].h };
+        val[i] = from->FindById(hp)->val;
+    }
+}
+
+extern "C" {
+
+void Slvs_QuaternionU(double qw, double qx, double qy, double qz,
+                         double *x, double *y, double *z)
+{
+    Quaternion q = Quaternion::From(qw, qx, qy, qz);
+    Vector v = q.RotationU();
+    *x = v.x;
+    *y = v.y;
+    *z = v.z;
+}
+
+void Slvs_QuaternionV(double qw, double qx, double qy, double qz,
+                         double *x, double *y, double *z)
+{
+    Quaternion q = Quaternion::From(qw, qx, qy, qz);
+    Vector v = q.RotationV();
+    *x = v.x;
+    *y = v.y;
+    *z = v.z;
+}
+
+void Slvs_QuaternionN(double qw, double qx, double qy, double qz,
+                         double *x, double *y, double *z)
+{
+    Quaternion q = Quaternion::From(qw, qx, qy, qz);
+    Vector v = q.RotationN();
+    *x = v.x;
+    *y = v.y;
+    *z = v.z;
+}
+
+void Slvs_MakeQuaternion(double ux, double uy, double uz,
+                         double vx, double vy, double vz,
+                         double *qw, double *qx, double *qy, double *qz)
+{
+    Vector u = Vector::From(ux, uy, uz),
+           v = Vector::From(vx, vy, vz);
+    Quaternion q = Quaternion::From(u, v);
+    *qw = q.w;
+    *qx = q.vx;
+    *qy = q.vy;
+    *qz = q.vz;
+}
+
+Slvs_Context *Slvs_CreateContext(void)
+{
+    InitLibrary();
+    return new Slvs_Context();
+}
+
+void Slvs_DestroyContext(Slvs_Context *ctx)
+{
+    delete ctx;
+}
+
+void Slvs_CancelContext(Slvs_Context *ctx)
+{
+    ctx->cancel = true;
+}
+
+void Slvs_Solve(Slvs_System *ssys, Slvs_hGroup shg)
+{
+    InitLibrary();
+    Slvs_SolveInContext(ThreadContext(), ssys, shg);
+}
+
+void Slvs_SolveInContext(Slvs_Context *ctx, Slvs_System *ssys, Slvs_hGroup shg)
+{
+    System *sys = &ctx->sys;
+    if(!WriteSketch(sys, ssys, shg, NULL)) {
+        ssys->result = SLVS_RESULT_UNRECOGNIZED;
+        ClearSketch(sys);
+        return;
     }
 
+    Group g = {};
+    g.h.v = shg;
+
+    List<hConstraint> bad = {};
+
+    // Now we're finally ready to solve!
+    bool andFindBad = ssys->calculateFaileds ? true : false;
+    SolveResult how = sys->Solve(&g, &(ssys->dof), &bad, andFindBad, /*andFindFree=*/false);
+    ssys->result = ResultFor(how);
+    if(how == SolveResult::CANCELLED) ctx->cancel = false;
+
     // Write the new parameter values back to our caller.
-    for(i = 0; i < ssys->params; i++) {
+    for(int i = 0; i < ssys->params; i++) {
         Slvs_Param *sp = &(ssys->param[i]);
         hParam hp = { sp->h };
         sp->val = SK.GetParam(hp)->val;
@@ -255,23 +346,207 @@ default: dbp("bad constraint type %d", sc->type); return;
 
     if(ssys->failed) {
         // Copy over any the list of problematic constraints.
-        for(i = 0; i < ssys->faileds && i < bad.n; i++) {
+        for(int i = 0; i < ssys->faileds && i < bad.n; i++) {
             ssys->failed[i] = bad.elem[i].v;
         }
         ssys->faileds = bad.n;
     }
 
     bad.Clear();
-    SYS.param.Clear();
-    SYS.entity.Clear();
-    SYS.eq.Clear();
-    SYS.dragged.Clear();
+    ClearSketch(sys);
+}
 
-    SK.param.Clear();
-    SK.entity.Clear();
-    SK.constraint.Clear();
+void Slvs_SolveBatch(Slvs_System *ssys, Slvs_hGroup shg,
+                     int count, double *vals, int *result, int *dof)
+{
+    InitLibrary();
+    Slvs_SolveBatchInContext(ThreadContext(), ssys, shg, count, vals, result, dof);
+}
 
-    FreeAllTemporary();
+void Slvs_SolveBatchInContext(Slvs_Context *ctx, Slvs_System *ssys, Slvs_hGroup shg,
+                              int count, double *vals, int *result, int *dof)
+{
+    if(count <= 0) return;
+
+    System *sys = &ctx->sys;
+    int n = ssys->params;
+    Group g = {};
+    g.h.v = shg;
+
+    // Solve one set from scratch, in the usual way, and write the equations
+    // and the Jacobians only for that; or for any set that can't use those.
+    std::vector<char> solved(count, 0);
+    bool cancelled = false;
+    auto solveAlone = [&](int k) {
+        double *val = &vals[(size_t)k*n];
+        solved[k] = 1;
+        if(sys->Cancelled()) {
+            // Don't bother writing the sketch only to stop straight away.
+            if(result) result[k] = SLVS_RESULT_CANCELLED;
+            cancelled = true;
+            return false;
+        }
+        if(!WriteSketch(sys, ssys, shg, val)) {
+            if(result) result[k] = SLVS_RESULT_UNRECOGNIZED;
+            return false;
+        }
+
+        List<hConstraint> bad = {};
+        SolveResult how = sys->Solve(&g, dof ? &dof[k] : NULL, &bad,
+                                     /*andFindBad=*/false, /*andFindFree=*/false);
+        if(result) result[k] = ResultFor(how);
+        if(how == SolveResult::CANCELLED) cancelled = true;
+        ReadParams(ssys, &SK.param, val);
+        bad.Clear();
+        return how == SolveResult::OKAY;
+    };
+
+    sys->keepJacobians = true;
+    bool okay = solveAlone(0);
+    if(okay && sys->dragCache.key != 0 && sys->dragCache.group.v == shg) {
+        // The Jacobians that we kept point in to a param table ordered like
+        // sys->param; find where each of those unknowns is in a set.
+        std::vector<int> column(sys->param.n, -1);
+        for(int i = 0; i < n; i++) {
+            if(ssys->param[i].group != shg) continue;
+            hParam hp = { ssys->param[i].h };
+            Param *p = sys->param.FindByIdNoOops(hp);
+            if(p) column[p - sys->param.elem] = i;
+        }
+        // Params from other groups are folded in to the Jacobians as
+        // constants, so only the sets that agree on those can use them.
+        std::vector<int> sameConstants;
+        for(int k = 1; k < count; k++) {
+            bool same = true;
+            for(int i = 0; i < n && same; i++) {
+                if(ssys->param[i].group == shg) continue;
+                if(vals[(size_t)k*n + i] != vals[i]) same = false;
+            }
+            if(same) sameConstants.push_back(k);
+        }
+
+        // Our sketch belongs to this thread, so the workers get its params
+        // from here.
+        ParamList *sketchParam = &SK.param;
+        ParallelFor(sameConstants.size(), [&](size_t j) {
+            int k = sameConstants[j];
+            double *val = &vals[(size_t)k*n];
+
+            System copy = {};
+            copy.cancel = sys->cancel;
+            copy.CopyDragCacheFrom(*sys);
+            for(int c = 0; c < sys->param.n; c++) {
+                Param p = sys->param.elem[c];
+                if(column[c] >= 0) p.val = val[column[c]];
+                copy.param.Add(&p);
+            }
+            ParamList dest = {};
+            for(int c = 0; c < sketchParam->n; c++) {
+                Param p = sketchParam->elem[c];
+                dest.Add(&p);
+            }
+
+            if(copy.SolveFromDragCache(dof ? &dof[k] : NULL, &dest)) {
+                if(result) result[k] = SLVS_RESULT_OKAY;
+                ReadParams(ssys, &dest, val);
+                solved[k] = 1;
+            }
+            dest.Clear();
+            copy.Clear();
+        });
+    }
+    sys->keepJacobians = false;
+    ClearSketch(sys);
+
+    // Anything that didn't converge from the kept Jacobians, or lost rank,
+    // gets solved from scratch, and so do the sets with other constants.
+    for(int k = 1; k < count; k++) {
+        if(solved[k]) continue;
+        solveAlone(k);
+        ClearSketch(sys);
+    }
+    if(cancelled) ctx->cancel = false;
+}
+
+void Slvs_Sweep(Slvs_System *ssys, Slvs_hGroup shg, Slvs_hConstraint shc,
+                double valStart, double valEnd, int steps,
+                Slvs_SweepCallback callback, void *data)
+{
+    InitLibrary();
+    Slvs_SweepInContext(ThreadContext(), ssys, shg, shc, valStart, valEnd, steps,
+                        callback, data);
+}
+
+void Slvs_SweepInContext(Slvs_Context *ctx, Slvs_System *ssys, Slvs_hGroup shg,
+                         Slvs_hConstraint shc, double valStart, double valEnd,
+                         int steps, Slvs_SweepCallback callback, void *data)
+{
+    System *sys = &ctx->sys;
+    hConstraint hc = { shc };
+    if(steps <= 0) return;
+    if(!WriteSketch(sys, ssys, shg, NULL) || !SK.constraint.FindByIdNoOops(hc)) {
+        ssys->result = SLVS_RESULT_UNRECOGNIZED;
+        ClearSketch(sys);
+        return;
+    }
+
+    // The dimension becomes a param that's neither known nor an unknown, so
+    // the compiled equations read it through a pointer, and stay the same
+    // from one step to the next.
+    Param vp = {};
+    vp.val = valStart;
+    hParam hvp = SK.param.AddAndAssignId(&vp);
+    SK.constraint.FindById(hc)->valAParam = hvp;
+    Param *valParam = SK.GetParam(hvp);
+
+    Group g = {};
+    g.h.v = shg;
+
+    sys->keepJacobians = true;
+    bool compiled = false;
+    for(int step = 0; step < steps; step++) {
+        double val = (steps == 1) ? valStart :
+                     valStart + (valEnd - valStart)*step/(steps - 1);
+        valParam->val = val;
+        SK.constraint.FindById(hc)->valA = val;
+
+        // Start from the last solution that we found, which is in the
+        // sketch, since a solve that fails doesn't write anything back.
+        for(Param &p : sys->param) {
+            p.val = SK.GetParam(p.h)->val;
+        }
+
+        SolveResult how;
+        if(compiled && sys->SolveFromDragCache(&(ssys->dof), &SK.param)) {
+            how = SolveResult::OKAY;
+        } else {
+            sys->eq.Clear();
+            List<hConstraint> bad = {};
+            how = sys->Solve(&g, &(ssys->dof), &bad, /*andFindBad=*/false,
+                             /*andFindFree=*/false);
+            bad.Clear();
+            compiled = (sys->dragCache.key != 0 && sys->dragCache.group.v == shg);
+        }
+        ssys->result = ResultFor(how);
+        if(how == SolveResult::CANCELLED) {
+            // Nothing was written back, so the params are still the last
+            // step's, which the callback has already seen.
+            ctx->cancel = false;
+            break;
+        }
+
+        for(int i = 0; i < ssys->params; i++) {
+            Slvs_Param *sp = &(ssys->param[i]);
+            hParam hp = { sp->h };
+            sp->val = SK.GetParam(hp)->val;
+        }
+        if(callback && callback(data, step, val, ssys)) break;
+    }
+
+    // The kept Jacobians point in to the sketch, which is about to go.
+    sys->ClearDragCache();
+    sys->keepJacobians = false;
+    ClearSketch(sys);
 }
 
 } /* extern "C" */
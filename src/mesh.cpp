@@ -262,26 +262,28 @@ void SMesh::AddAgainstBsp(SMesh *srcm, SBsp3 *bsp3) {
     }
 }
 
-void SMesh::MakeFromUnionOf(SMesh *a, SMesh *b) {
+void SMesh::MakeFromUnionOf(SMesh *a, SMesh *b, const CancelToken &cancel) {
     SBsp3 *bspa = SBsp3::FromMesh(a);
     SBsp3 *bspb = SBsp3::FromMesh(b);
 
     flipNormal = false;
     keepCoplanar = false;
     AddAgainstBsp(b, bspa);
+    if(cancel.Requested()) return;
 
     flipNormal = false;
     keepCoplanar = true;
     AddAgainstBsp(a, bspb);
 }
 
-void SMesh::MakeFromDifferenceOf(SMesh *a, SMesh *b) {
+void SMesh::MakeFromDifferenceOf(SMesh *a, SMesh *b, const CancelToken &cancel) {
     SBsp3 *bspa = SBsp3::FromMesh(a);
     SBsp3 *bspb = SBsp3::FromMesh(b);
 
     flipNormal = true;
     keepCoplanar = true;
     AddAgainstBsp(b, bspa);
+    if(cancel.Requested()) return;
 
     flipNormal = false;
     keepCoplanar = false;
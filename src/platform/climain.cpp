@@ -48,6 +48,9 @@ Commands:
         Exports exact surfaces of solids in the sketch, if any.
     regenerate
         Reloads all imported files, regenerates the sketch, and saves it.
+    solver-stats --output <pattern>
+        Writes what the solver did for each group when the sketch was loaded,
+        and how long each stage took, as JSON.
 )");
 
     auto FormatListFromFileFilter = [](const FileFilter *filter) {
@@ -83,6 +86,75 @@ File formats:
     FormatListFromFileFilter(SurfaceFileFilter).c_str());
 }
 
+static std::string JsonString(const std::string &s) {
+    std::string out = "\"";
+    for(char c : s) {
+        if(c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if((unsigned char)c < 0x20) {
+            out += ssprintf("\\u%04x", c);
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static const char *SolveResultName(SolveResult how) {
+    switch(how) {
+        case SolveResult::OKAY:                     return "okay";
+        case SolveResult::DIDNT_CONVERGE:           return "didnt-converge";
+        case SolveResult::REDUNDANT_OKAY:           return "redundant-okay";
+        case SolveResult::REDUNDANT_DIDNT_CONVERGE: return "redundant-didnt-converge";
+        case SolveResult::TOO_MANY_UNKNOWNS:        return "too-many-unknowns";
+        case SolveResult::CANCELLED:                return "cancelled";
+    }
+    return "unknown";
+}
+
+static void WriteSolverStats(const Platform::Path &output) {
+    FILE *f = OpenFile(output, "wb");
+    if(!f) {
+        fprintf(stderr, "Cannot write '%s'!\n", output.raw.c_str());
+        return;
+    }
+
+    fprintf(f, "{\n  \"groups\": [");
+    bool first = true;
+    for(hGroup hg : SK.groupOrder) {
+        if(hg.v == Group::HGROUP_REFERENCES.v) continue;
+        Group *g = SK.GetGroup(hg);
+        const SolveStats &st = g->solved.stats;
+
+        fprintf(f, "%s\n    {\n", first ? "" : ",");
+        first = false;
+        fprintf(f, "      \"group\": %u,\n", hg.v);
+        fprintf(f, "      \"name\": %s,\n", JsonString(g->DescriptionString()).c_str());
+        fprintf(f, "      \"result\": \"%s\",\n", SolveResultName(g->solved.how));
+        fprintf(f, "      \"dof\": %d,\n", g->solved.dof);
+        fprintf(f, "      \"equations\": %d,\n", st.equations);
+        fprintf(f, "      \"unknowns\": %d,\n", st.unknowns);
+        fprintf(f, "      \"substituted\": %d,\n", st.substituted);
+        fprintf(f, "      \"solvedAlone\": %d,\n", st.solvedAlone);
+        fprintf(f, "      \"blocks\": %d,\n", st.blocks);
+        fprintf(f, "      \"iterations\": %d,\n", st.iterations);
+        fprintf(f, "      \"rankTests\": %d,\n", st.rankTests);
+        fprintf(f, "      \"initialResidual\": %.9g,\n", st.initialResidual);
+        fprintf(f, "      \"finalResidual\": %.9g,\n", st.finalResidual);
+        fprintf(f, "      \"ms\": {\n");
+        fprintf(f, "        \"write\": %.3f,\n", st.writeMs);
+        fprintf(f, "        \"substitute\": %.3f,\n", st.substituteMs);
+        fprintf(f, "        \"newton\": %.3f,\n", st.newtonMs);
+        fprintf(f, "        \"rank\": %.3f,\n", st.rankMs);
+        fprintf(f, "        \"findBad\": %.3f,\n", st.findBadMs);
+        fprintf(f, "        \"total\": %.3f\n", st.totalMs);
+        fprintf(f, "      }\n    }");
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+}
+
 static bool RunCommand(const std::vector<std::string> args) {
     if(args.size() < 2) return false;
 
@@ -281,6 +353,18 @@ static bool RunCommand(const std::vector<std::string> args) {
         runner = [&](const Platform::Path &output) {
             SS.SaveToFile(output);
         };
+    } else if(args[1] == "solver-stats") {
+        for(size_t argn = 2; argn < args.size(); argn++) {
+            if(!(ParseInputFile(argn) ||
+                 ParseOutputPattern(argn))) {
+                fprintf(stderr, "Unrecognized option '%s'.\n", args[argn].c_str());
+                return false;
+            }
+        }
+
+        runner = [&](const Platform::Path &output) {
+            WriteSolverStats(output);
+        };
     } else {
         fprintf(stderr, "Unrecognized command '%s'.\n", args[1].c_str());
         return false;
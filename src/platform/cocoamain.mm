@@ -491,6 +491,14 @@ bool FullScreenIsActive() {
     return [GWDelegate isFullscreen];
 }
 
+bool EscapeKeyIsDown() {
+    if(![NSApp isActive]) return false;
+
+    // We're not in the event loop, so look at the keyboard directly;
+    // 53 is kVK_Escape.
+    return CGEventSourceKeyState(kCGEventSourceStateCombinedSessionState, 53);
+}
+
 void ShowGraphicsEditControl(int x, int y, int fontHeight, int minWidthChars,
                              const std::string &str) {
     [GWView startEditing:Wrap(str)
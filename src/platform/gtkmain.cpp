@@ -40,6 +40,7 @@
 #include <cairomm/xlib_surface.h>
 #include <pangomm/fontdescription.h>
 #include <gdk/gdkx.h>
+#include <X11/keysym.h>
 #include <fontconfig/fontconfig.h>
 
 #include <GL/glx.h>
@@ -1272,6 +1273,30 @@ double GetScreenDpi() {
     return Gdk::Screen::get_default()->get_resolution();
 }
 
+bool EscapeKeyIsDown() {
+    if(!(GW->is_active() || TW->is_active())) return false;
+
+#if defined(GDK_WINDOWING_X11)
+    // We're not in the event loop, so ask the X server about the keyboard;
+    // that's a round trip, so not more often than every 50 ms.
+    if(GDK_IS_X11_DISPLAY(Gdk::Display::get_default()->gobj())) {
+        static int64_t lastAsked = 0;
+        static bool down = false;
+        int64_t now = GetMilliseconds();
+        if(now - lastAsked >= 50) {
+            lastAsked = now;
+            Display *display = gdk_x11_get_default_xdisplay();
+            KeyCode escape = XKeysymToKeycode(display, XK_Escape);
+            char keys[32];
+            XQueryKeymap(display, keys);
+            down = (keys[escape / 8] & (1 << (escape % 8))) != 0;
+        }
+        return down;
+    }
+#endif
+    return false;
+}
+
 void InvalidateText(void) {
     TW->get_widget().queue_draw();
 }
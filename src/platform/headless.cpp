@@ -155,6 +155,14 @@ void ToggleFullScreen() {
 bool FullScreenIsActive() {
     return false;
 }
+// For tests; the Esc key reads as down on the escapeDownAtPoll'th time that
+// it's asked about, counting in escapePolls.
+int escapePolls = 0;
+int escapeDownAtPoll = 0;
+bool EscapeKeyIsDown() {
+    escapePolls++;
+    return escapePolls == escapeDownAtPoll;
+}
 void ShowGraphicsEditControl(int x, int y, int fontHeight, int minWidthChars,
                              const std::string &val) {
     ssassert(false, "Not implemented");
@@ -15,7 +15,9 @@ namespace SolveSpace {
 void dbp(const char *str, ...)
 {
     va_list f;
-    static char buf[1024*50];
+    // One per thread, since the solver library may be called from several
+    // threads at once, and reports what it doesn't recognize through here.
+    static thread_local char buf[1024*50];
     va_start(f, str);
     vsnprintf(buf, sizeof(buf), str, f);
     va_end(f);
@@ -53,7 +55,15 @@ void assert_failure(const char *file, unsigned line, const char *function,
 // A separate heap, on which we allocate expressions. Maybe a bit faster,
 // since fragmentation is less of a concern, and it also makes it possible
 // to be sloppy with our memory management, and just free everything at once
-// at the end.
+// at the end. Each thread has its own, so that the library can solve in
+// several threads at once.
+//
+// Temporaries are bumped out of big chunks, which are kept across
+// FreeAllTemporary and just rewound, so freeing everything costs nothing
+// per allocation. Anything too big to pack gets its own block instead, on a
+// list so that it can be freed alone. Each allocation is preceded by its
+// size, so that FreeTemporary can tell the two apart; freeing the latest
+// small one rewinds over it, and freeing any other waits for the reset.
 //-----------------------------------------------------------------------------
 
 typedef struct _AllocTempHeader AllocTempHeader;
@@ -63,41 +73,89 @@ typedef struct _AllocTempHeader {
     AllocTempHeader *next;
 } AllocTempHeader;
 
-static AllocTempHeader *Head = NULL;
+static const size_t TempAlign     = 16;
+static const size_t TempSizeBytes = TempAlign;
+static const size_t TempChunkSize = 1024*1024;
+static const size_t TempLargeSize = TempChunkSize/4;
+
+struct TempArena {
+    std::vector<char *> chunks;
+    size_t              chunk;  // the one that we're bumping in to
+    size_t              used;   // and how much of it is taken
+    AllocTempHeader    *large;
+
+    ~TempArena() {
+        for(char *c : chunks) free(c);
+        while(large) {
+            AllocTempHeader *f = large;
+            large = large->next;
+            free(f);
+        }
+    }
+};
+static thread_local TempArena Temp;
 
 void *AllocTemporary(size_t n)
 {
-    AllocTempHeader *h =
-        (AllocTempHeader *)malloc(n + sizeof(AllocTempHeader));
-    h->prev = NULL;
-    h->next = Head;
-    if(Head) Head->prev = h;
-    Head = h;
-    memset(&h[1], 0, n);
-    return (void *)&h[1];
+    size_t need = TempSizeBytes + ((n + TempAlign - 1) & ~(TempAlign - 1));
+    char *c;
+    if(need > TempLargeSize) {
+        AllocTempHeader *h =
+            (AllocTempHeader *)malloc(sizeof(AllocTempHeader) + need);
+        ssassert(h != NULL, "Cannot allocate memory");
+        h->prev = NULL;
+        h->next = Temp.large;
+        if(Temp.large) Temp.large->prev = h;
+        Temp.large = h;
+        c = (char *)&h[1];
+    } else {
+        if(Temp.chunks.empty() || Temp.used + need > TempChunkSize) {
+            if(!Temp.chunks.empty()) Temp.chunk++;
+            if(Temp.chunk == Temp.chunks.size()) {
+                char *chunk = (char *)malloc(TempChunkSize);
+                ssassert(chunk != NULL, "Cannot allocate memory");
+                Temp.chunks.push_back(chunk);
+            }
+            Temp.used = 0;
+        }
+        c = Temp.chunks[Temp.chunk] + Temp.used;
+        Temp.used += need;
+    }
+    *(size_t *)c = need;
+    memset(c + TempSizeBytes, 0, n);
+    return (void *)(c + TempSizeBytes);
 }
 
 void FreeTemporary(void *p)
 {
-    AllocTempHeader *h = (AllocTempHeader *)p - 1;
-    if(h->prev) {
-        h->prev->next = h->next;
-    } else {
-        Head = h->next;
+    char *c = (char *)p - TempSizeBytes;
+    size_t need = *(size_t *)c;
+    if(need > TempLargeSize) {
+        AllocTempHeader *h = (AllocTempHeader *)c - 1;
+        if(h->prev) {
+            h->prev->next = h->next;
+        } else {
+            Temp.large = h->next;
+        }
+        if(h->next) h->next->prev = h->prev;
+        free(h);
+    } else if(c + need == Temp.chunks[Temp.chunk] + Temp.used) {
+        Temp.used -= need;
     }
-    if(h->next) h->next->prev = h->prev;
-    free(h);
 }
 
 void FreeAllTemporary(void)
 {
-    AllocTempHeader *h = Head;
+    AllocTempHeader *h = Temp.large;
     while(h) {
         AllocTempHeader *f = h;
         h = h->next;
         free(f);
     }
-    Head = NULL;
+    Temp.large = NULL;
+    Temp.chunk = 0;
+    Temp.used  = 0;
+    Expr::ForgetInterned();
 }
 
 void *MemAlloc(size_t n) {
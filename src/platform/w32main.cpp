@@ -966,6 +966,15 @@ bool SolveSpace::FullScreenIsActive()
     return (GetWindowLong(GraphicsWnd, GWL_STYLE) & WS_OVERLAPPEDWINDOW) != 0;
 }
 
+bool SolveSpace::EscapeKeyIsDown()
+{
+    HWND foreground = GetForegroundWindow();
+    if(foreground != GraphicsWnd && foreground != TextWnd) return false;
+
+    // We're not in the message loop, so look at the keyboard directly.
+    return (GetAsyncKeyState(VK_ESCAPE) & 0x8000) != 0;
+}
+
 void SolveSpace::InvalidateText()
 {
     InvalidateRect(TextWnd, NULL, false);
@@ -13,12 +13,15 @@
 #include <shellapi.h>
 
 namespace SolveSpace {
-static HANDLE PermHeap, TempHeap;
+static HANDLE PermHeap;
+static thread_local HANDLE TempHeap;
 
 void dbp(const char *str, ...)
 {
     va_list f;
-    static char buf[1024*50];
+    // One per thread, since the solver library may be called from several
+    // threads at once, and reports what it doesn't recognize through here.
+    static thread_local char buf[1024*50];
     va_start(f, str);
     _vsnprintf(buf, sizeof(buf), str, f);
     va_end(f);
@@ -50,10 +53,12 @@ void assert_failure(const char *file, unsigned line, const char *function,
 // A separate heap, on which we allocate expressions. Maybe a bit faster,
 // since no fragmentation issues whatsoever, and it also makes it possible
 // to be sloppy with our memory management, and just free everything at once
-// at the end.
+// at the end. Each thread has its own, so that the library can solve in
+// several threads at once; the long-lived heap is shared, and serialized.
 //-----------------------------------------------------------------------------
 void *AllocTemporary(size_t n)
 {
+    if(!TempHeap) TempHeap = HeapCreate(HEAP_NO_SERIALIZE, 1024*1024*20, 0);
     void *v = HeapAlloc(TempHeap, HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY, n);
     ssassert(v != NULL, "Cannot allocate memory");
     return v;
@@ -65,28 +70,29 @@ void FreeAllTemporary()
 {
     if(TempHeap) HeapDestroy(TempHeap);
     TempHeap = HeapCreate(HEAP_NO_SERIALIZE, 1024*1024*20, 0);
+    Expr::ForgetInterned();
     // This is a good place to validate, because it gets called fairly
     // often.
     vl();
 }
 
 void *MemAlloc(size_t n) {
-    void *p = HeapAlloc(PermHeap, HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY, n);
+    void *p = HeapAlloc(PermHeap, HEAP_ZERO_MEMORY, n);
     ssassert(p != NULL, "Cannot allocate memory");
     return p;
 }
 void MemFree(void *p) {
-    HeapFree(PermHeap, HEAP_NO_SERIALIZE, p);
+    HeapFree(PermHeap, 0, p);
 }
 
 void vl() {
-    ssassert(HeapValidate(TempHeap, HEAP_NO_SERIALIZE, NULL), "Corrupted heap");
-    ssassert(HeapValidate(PermHeap, HEAP_NO_SERIALIZE, NULL), "Corrupted heap");
+    ssassert(!TempHeap || HeapValidate(TempHeap, HEAP_NO_SERIALIZE, NULL), "Corrupted heap");
+    ssassert(HeapValidate(PermHeap, 0, NULL), "Corrupted heap");
 }
 
 std::vector<std::string> InitPlatform(int argc, char **argv) {
     // Create the heap used for long-lived stuff (that gets freed piecewise).
-    PermHeap = HeapCreate(HEAP_NO_SERIALIZE, 1024*1024*20, 0);
+    PermHeap = HeapCreate(0, 1024*1024*20, 0);
     // Create the heap that we use to store Exprs and other temp stuff.
     FreeAllTemporary();
 
@@ -266,8 +266,9 @@ public:
     void Simplify(int start);
 
     void AddAgainstBsp(SMesh *srcm, SBsp3 *bsp3);
-    void MakeFromUnionOf(SMesh *a, SMesh *b);
-    void MakeFromDifferenceOf(SMesh *a, SMesh *b);
+    // A Boolean that's cancelled partway leaves only some of the triangles.
+    void MakeFromUnionOf(SMesh *a, SMesh *b, const CancelToken &cancel = {});
+    void MakeFromDifferenceOf(SMesh *a, SMesh *b, const CancelToken &cancel = {});
 
     void MakeFromCopyOf(SMesh *a);
     void MakeFromTransformationOf(SMesh *a, Vector trans,
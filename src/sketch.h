@@ -159,6 +159,7 @@ public:
         SolveResult         how;
         int                 dof;
         List<hConstraint>   remove;
+        SolveStats          stats;
     } solved;
 
     enum class Subtype : uint32_t {
@@ -201,6 +202,12 @@ public:
     SMesh           thisMesh;
     SMesh           runningMesh;
 
+    // Hashes of whatever the shells and meshes above were made from, so that
+    // they can be found again in the cache of Boolean results; or zero, if
+    // not known.
+    uint64_t        thisKey;
+    uint64_t        runningKey;
+
     bool            displayDirty;
     SMesh           displayMesh;
     SOutlineList    displayOutlines;
@@ -253,7 +260,7 @@ public:
     };
     hEntity Remap(hEntity in, int copyNumber);
     void MakeExtrusionLines(EntityList *el, hEntity in);
-    void MakeLatheCircles(IdList<Entity,hEntity> *el, IdList<Param,hParam> *param, hEntity in, Vector pt, Vector axis, int ai);
+    void MakeLatheCircles(EntityList *el, ParamList *param, hEntity in, Vector pt, Vector axis, int ai);
     void MakeExtrusionTopBottomFaces(EntityList *el, hEntity pt);
     void CopyEntity(EntityList *el,
                     Entity *ep, int timesApplied, int remap,
@@ -277,9 +284,16 @@ public:
     Group *RunningMeshGroup() const;
     bool IsMeshGroup();
 
-    void GenerateShellAndMesh();
-    template<class T> void GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat);
-    template<class T> void GenerateForBoolean(T *a, T *b, T *o, Group::CombineAs how);
+    // If cancel is requested partway, then these return early, and leave the
+    // group's shells and meshes incomplete, for the caller to throw away.
+    void GenerateShellAndMesh(const CancelToken &cancel = {});
+    void GenerateThisShellAndMesh(const CancelToken &cancel);
+    void GenerateRunningShellAndMesh(const CancelToken &cancel);
+    uint64_t StepAndRepeatKey();
+    template<class T> void GenerateForStepAndRepeat(T *steps, T *outs, Group::CombineAs forWhat,
+                                                    const CancelToken &cancel);
+    template<class T> void GenerateForBoolean(T *a, T *b, T *o, Group::CombineAs how,
+                                              const CancelToken &cancel);
     void GenerateDisplayItems();
 
     enum class DrawMeshAs { DEFAULT, HOVERED, SELECTED };
@@ -641,6 +655,9 @@ public:
     // These are the parameters for the constraint.
     double      valA;
     hParam      valP;
+    // If set, valA is read from this param instead, so that the equations
+    // stay the same when the dimension changes; for sweeping it.
+    hParam      valAParam;
     hEntity     ptA;
     hEntity     ptB;
     hEntity     entityA;
@@ -655,7 +672,7 @@ public:
 
     bool HasLabel() const;
 
-    void Generate(IdList<Param, hParam> *param);
+    void Generate(ParamList *param);
 
     void GenerateEquations(IdList<Equation,hEquation> *entity,
                            bool forReference = false) const;
@@ -70,6 +70,8 @@ void SolveSpaceUI::Init() {
     drawBackFaces = CnfThawBool(true, "DrawBackFaces");
     // Check that contours are closed and not self-intersecting
     checkClosedContour = CnfThawBool(true, "CheckClosedContour");
+    // Keep the solid model in a file beside the sketch, to open it faster
+    regenCache = CnfThawBool(false, "RegenCache");
     // Draw closed polygons areas
     showContourAreas = CnfThawBool(false, "ShowContourAreas");
     // Export shaded triangles in a 2d view
@@ -146,7 +148,13 @@ bool SolveSpaceUI::Load(const Platform::Path &filename) {
         saveFile.Clear();
         NewFile();
     }
+    // The cache is only good for the sketch exactly as it was saved.
+    bool useRegenCache = (regenCache && fileLoaded && !autosaveLoaded);
+    bool regenCacheLoaded = useRegenCache && LoadRegenCache(filename);
     AfterNewFile();
+    if(useRegenCache && !regenCacheLoaded) {
+        SaveRegenCache(filename);
+    }
     unsaved = autosaveLoaded;
     return fileLoaded;
 }
@@ -197,6 +205,8 @@ void SolveSpaceUI::Exit() {
     CnfFreezeBool(showContourAreas, "ShowContourAreas");
     // Check that contours are closed and not self-intersecting
     CnfFreezeBool(checkClosedContour, "CheckClosedContour");
+    // Keep the solid model in a file beside the sketch, to open it faster
+    CnfFreezeBool(regenCache, "RegenCache");
     // Export shaded triangles in a 2d view
     CnfFreezeBool(exportShadedTriangles, "ExportShadedTriangles");
     // Export pwl curves (instead of exact) always
@@ -375,6 +385,7 @@ bool SolveSpaceUI::GetFilenameAndSave(bool saveAs) {
     }
 
     if(SaveToFile(newSaveFile)) {
+        if(regenCache) SaveRegenCache(newSaveFile);
         AddToRecentList(newSaveFile);
         RemoveAutosave();
         saveFile = newSaveFile;
@@ -866,6 +877,7 @@ void SolveSpaceUI::MenuHelp(Command id) {
 
 void SolveSpaceUI::Clear() {
     sys.Clear();
+    ForgetCachedShells();
     for(int i = 0; i < MAX_UNDO; i++) {
         if(i < undo.cnt) undo.d[i].Clear();
         if(i < redo.cnt) redo.d[i].Clear();
@@ -880,6 +892,7 @@ void Sketch::Clear() {
     style.Clear();
     entity.Clear();
     param.Clear();
+    ForgetItemsByGroup();
 }
 
 BBox Sketch::CalculateEntityBBox(bool includingInvisible) {
@@ -33,6 +33,7 @@
 #include <map>
 #include <set>
 #include <chrono>
+#include <atomic>
 #include <sstream>
 
 // We declare these in advance instead of simply using FT_Library
@@ -152,6 +153,7 @@ DialogChoice LocateImportedFileYesNoCancel(const Platform::Path &filename,
                                            bool canCancel);
 
 #define AUTOSAVE_EXT "slvs~"
+#define REGEN_CACHE_EXT "slvscache"
 
 enum class Unit : uint32_t {
     MM = 0,
@@ -193,6 +195,10 @@ void InvalidateGraphics();
 void PaintGraphics();
 void ToggleFullScreen();
 bool FullScreenIsActive();
+// For slow operations that don't return to the event loop; whether Esc is
+// held down while one of our windows has the focus. This is asked often, so
+// a platform where that's slow to find out should answer from a recent look.
+bool EscapeKeyIsDown();
 void GetGraphicsWindowSize(int *w, int *h);
 void GetTextWindowSize(int *w, int *h);
 double GetScreenDpi();
@@ -241,6 +247,20 @@ struct CompareHandle {
 template<class Key, class T>
 using handle_map = std::map<Key, T, CompareHandle<Key>>;
 
+// Lets a slow operation be asked to stop partway. It stops once what flag
+// points to is set, perhaps by another thread; and if poll is set, then it's
+// called each time that we check, and may set the flag itself.
+class CancelToken {
+public:
+    std::atomic<bool>   *flag;
+    void                (*poll)();
+
+    bool Requested() const {
+        if(poll) poll();
+        return flag != NULL && flag->load(std::memory_order_relaxed);
+    }
+};
+
 class Group;
 class SSurface;
 #include "dsc.h"
@@ -252,15 +272,39 @@ class Entity;
 class hEntity;
 class Param;
 class hParam;
-typedef IdList<Entity,hEntity> EntityList;
-typedef IdList<Param,hParam> ParamList;
+typedef IdList<Entity,hEntity,/*Indexed=*/true> EntityList;
+typedef IdList<Param,hParam,/*Indexed=*/true> ParamList;
 
 enum class SolveResult : uint32_t {
     OKAY                     = 0,
     DIDNT_CONVERGE           = 10,
     REDUNDANT_OKAY           = 11,
     REDUNDANT_DIDNT_CONVERGE = 12,
-    TOO_MANY_UNKNOWNS        = 20
+    TOO_MANY_UNKNOWNS        = 20,
+    CANCELLED                = 30
+};
+
+// What the solver did for a group, and how long it took.
+struct SolveStats {
+    int     equations;
+    int     unknowns;
+    int     substituted;
+    int     solvedAlone;
+    int     blocks;
+    int     iterations;
+    int     rankTests;
+    bool    fromDragCache;
+    // The 2-norm of the residuals, before and after solving
+    double  initialResidual;
+    double  finalResidual;
+    // Wall time per stage, in milliseconds; the blocks may be solved
+    // concurrently, and then their Newton and rank test times are summed.
+    double  writeMs;
+    double  substituteMs;
+    double  newtonMs;
+    double  rankMs;
+    double  findBadMs;
+    double  totalMs;
 };
 
 
@@ -298,6 +342,11 @@ void MakeMatrix(double *mat, double a11, double a12, double a13, double a14,
                              double a41, double a42, double a43, double a44);
 void MultMatrix(double *mata, double *matb, double *matr);
 
+// Run fn(0) ... fn(n - 1) on a pool of worker threads, and return once all
+// of them are done. The calls must not depend on each other, nor allocate
+// temporary memory.
+void ParallelFor(size_t n, const std::function<void(size_t)> &fn);
+
 std::string MakeAcceleratorLabel(int accel);
 void Message(const char *str, ...);
 void Error(const char *str, ...);
@@ -309,8 +358,6 @@ RgbaColor CnfThawColor(RgbaColor v, const std::string &name);
 
 class System {
 public:
-    enum { MAX_UNKNOWNS = 1024 };
-
     EntityList                      entity;
     ParamList                       param;
     IdList<Equation,hEquation>      eq;
@@ -322,58 +369,187 @@ public:
     enum {
         // In general, the tag indicates the subsys that a variable/equation
         // has been assigned to; these are exceptions for variables:
-        VAR_SUBSTITUTED      = 10000,
-        VAR_DOF_TEST         = 10001,
+        VAR_SUBSTITUTED      = -1,
+        VAR_DOF_TEST         = -2,
         // and for equations:
-        EQ_SUBSTITUTED       = 20000
+        EQ_SUBSTITUTED       = -3
     };
 
-    // The system Jacobian matrix
-    struct {
+    // What's left after substitution and the single-equation solves is
+    // split in to blocks that share no unknowns, and are solved separately;
+    // the subsys tags of the blocks are [firstBlock, firstBlock + blocks).
+    int firstBlock;
+    int blocks;
+
+    // How the partials in the Jacobian are found: by reverse-mode automatic
+    // differentiation over the tape of each residual, or by differentiating
+    // the equations symbolically. The two agree up to rounding; the symbolic
+    // path is slower, and is kept to validate the other against.
+    enum class Partials : uint32_t {
+        AUTODIFF = 0,
+        SYMBOLIC = 1
+    };
+    Partials partials;
+
+    // How the least squares step solves A*A'*Z = B: by a sparse LDL'
+    // factorization, or by dense Gaussian elimination, which is kept as a
+    // fallback.
+    enum class LeastSquares : uint32_t {
+        SPARSE = 0,
+        DENSE  = 1
+    };
+    LeastSquares leastSquares;
+
+    // A sparse LDL' factorization of a symmetric matrix, in a fill-reducing
+    // order. The symbolic part depends only on where the nonzeros are, so
+    // it's found once, and reused as the values change.
+    struct SparseLDL {
+        int                     n;
+        // The permuted matrix's diagonal and upper triangle, by columns;
+        // with perm[k] the original row and column of pivot k.
+        std::vector<int>        perm;
+        std::vector<int>        Ap, Ai;
+        std::vector<double>     Ax;
+        // The elimination tree, and the strictly lower L, by columns
+        std::vector<int>        parent;
+        std::vector<int>        Lp, Li;
+        std::vector<double>     Lx;
+        std::vector<double>     D;
+        // Pivots that were (numerically) zero, so the matrix is singular
+        std::vector<bool>       zero;
+
+        void Analyze(int n, const std::vector<std::vector<int>> &adj);
+        void Factor();
+        void Solve(double *x) const;
+    };
+
+    // The Jacobian matrix of a subsystem. Each equation references only a
+    // handful of parameters, so the Jacobian is stored by rows, with only the
+    // partials that aren't identically zero.
+    struct Jacobian {
+        Partials                partials;
+
         // The corresponding equation for each row
-        hEquation   eq[MAX_UNKNOWNS];
+        std::vector<hEquation>  eq;
 
         // The corresponding parameter for each column
-        hParam      param[MAX_UNKNOWNS];
+        std::vector<hParam>     param;
+        // The values that the tapes load; the first n slots are the columns.
+        ExprParams              values;
+
+        // The system's cancel flag, for the slow loops that don't have it;
+        // without its poll, since those loops may run on worker threads.
+        const std::atomic<bool> *cancel;
 
         // We're solving AX = B
         int m, n;
         struct {
-            Expr        *sym[MAX_UNKNOWNS][MAX_UNKNOWNS];
-            double       num[MAX_UNKNOWNS][MAX_UNKNOWNS];
+            // Row i is stored in [start[i], start[i+1]), sorted by column.
+            std::vector<int>        start;
+            std::vector<int>        col;
+            // The partials, compiled in that same order, if symbolic
+            ExprTape                sym;
+            std::vector<double>     num;
         }           A;
 
-        double      scale[MAX_UNKNOWNS];
+        // With automatic differentiation, each place where the residual of
+        // row i loads a parameter is a register in B.sym, whose adjoint is
+        // summed in to an entry of A; those are [start[i], start[i+1]).
+        struct {
+            std::vector<int>        start;
+            std::vector<uint32_t>   reg;
+            std::vector<int>        entry;
+        }           load;
+
+        std::vector<double>     scale;
 
         // Some helpers for the least squares solve
-        double AAt[MAX_UNKNOWNS][MAX_UNKNOWNS];
-        double Z[MAX_UNKNOWNS];
+        LeastSquares            leastSquares;
+        std::vector<double>     AAt;
+        SparseLDL               ldl;
+        // Which rows of A are dotted to get each entry of ldl.Ax; empty if
+        // it hasn't been analyzed for this A yet.
+        std::vector<std::pair<int, int>> ldlRows;
+        std::vector<double>     Z;
 
-        double      X[MAX_UNKNOWNS];
+        std::vector<double>     X;
 
         struct {
-            Expr        *sym[MAX_UNKNOWNS];
-            double       num[MAX_UNKNOWNS];
+            ExprTape                sym;
+            std::vector<double>     num;
         }           B;
-    } mat;
 
-    static const double RANK_MAG_TOLERANCE, CONVERGE_TOLERANCE;
-    int CalculateRank();
-    bool TestRank();
-    static bool SolveLinearSystem(double X[], double A[][MAX_UNKNOWNS],
-                                  double B[], int N);
-    bool SolveLeastSquares();
+        // What was done with this Jacobian, for our SolveStats; the
+        // residuals are sums of squares.
+        int                     iterations;
+        int                     rankTests;
+        double                  initialResidual;
+        double                  finalResidual;
+        double                  newtonMs;
+        double                  rankMs;
+    };
+    Jacobian mat;
+
+    SolveStats stats;
+    void CountStats(const Jacobian *J);
 
-    bool WriteJacobian(int tag);
-    void EvalJacobian();
+    // The blocks are solved concurrently when there's enough work to go
+    // around; below this many Jacobian entries in total, it isn't worth it.
+    static const size_t PARALLEL_MIN_ENTRIES;
+
+    static const double RANK_MAG_TOLERANCE, CONVERGE_TOLERANCE;
+    static int CalculateRank(Jacobian *J, std::vector<bool> *independent = NULL);
+    static bool TestRank(Jacobian *J);
+    static bool SolveLinearSystem(double X[], double A[], double B[], int N);
+    static void MinimumDegreeOrder(const std::vector<std::vector<int>> &adj,
+                                   std::vector<int> *perm);
+    static void AnalyzeLeastSquares(Jacobian *J);
+    static void FactorNormalEquations(Jacobian *J);
+    static void LeftNullSpace(Jacobian *J, std::vector<std::vector<double>> *null);
+    bool SolveLeastSquares(Jacobian *J);
+
+    void WriteJacobian(int tag, Jacobian *J);
+    static void EvalJacobian(Jacobian *J);
 
     void WriteEquationsExceptFor(hConstraint hc, Group *g);
     void FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad, bool forceDofCheck);
     void SolveBySubstitution();
+    void FindBlocks(int firstTag);
+    bool IsBlockTag(int tag) const;
+    static void AddUnsatisfiedConstraints(Jacobian *J, List<hConstraint> *bad);
 
     bool IsDragged(hParam p);
 
-    bool NewtonSolve(int tag);
+    // While something is dragged, the same system is solved once per frame,
+    // with only the values of the unknowns changed. So after a solve that
+    // moves a dragged param, its Jacobians are kept, along with the param
+    // table that they point in to; if the next system written has the same
+    // key, they're solved again without writing or differentiating anything.
+    // If keepJacobians is set, then they're kept after any solve, dragged
+    // or not; that's for solving a batch of systems with the same equations,
+    // or a sweep. Then they may also point at params in the sketch that are
+    // neither known nor unknowns, and the caller must keep those in place.
+    bool keepJacobians;
+    // If this has a flag, then another thread may ask for a solve to stop
+    // early; the solve then returns CANCELLED, and writes nothing back.
+    CancelToken cancel;
+    bool Cancelled() const { return cancel.Requested(); }
+    struct {
+        uint64_t                key = 0;
+        hGroup                  group = {};
+        ParamList               param;
+        std::vector<Jacobian>   alone;
+        std::vector<Jacobian>   block;
+        int                     dof;
+    } dragCache;
+
+    uint64_t DragKey(Group *g, bool forceDofCheck);
+    bool SolveFromDragCache(int *dof, ParamList *dest);
+    void CopyDragCacheFrom(const System &from);
+    void ClearDragCache();
+    void WriteParamsBack(ParamList *dest);
+
+    bool NewtonSolve(Jacobian *J);
 
     void MarkParamsFree(bool findFree);
     int CalculateDof();
@@ -575,8 +751,8 @@ public:
     IdList<Style,hStyle>            style;
 
     // These are generated from the above.
-    IdList<ENTITY,hEntity>          entity;
-    IdList<Param,hParam>            param;
+    IdList<ENTITY,hEntity,true>     entity;
+    IdList<Param,hParam,true>       param;
 
     inline CONSTRAINT *GetConstraint(hConstraint h)
         { return constraint.FindById(h); }
@@ -586,6 +762,49 @@ public:
     inline Group   *GetGroup  (hGroup   h) { return group.  FindById(h); }
     // Styles are handled a bit differently.
 
+    // The requests and constraints in a group, by their index in the lists
+    // above, in the order that they appear there.
+    struct GroupItems {
+        std::vector<int>    request;
+        std::vector<int>    constraint;
+    };
+    // While regenerating, those are indexed for every group at once, so that
+    // each group doesn't have to search the whole sketch for its own. The
+    // index is valid only until either list next changes, so it must be
+    // forgotten before then.
+    std::unordered_map<uint32_t, GroupItems> itemsByGroup;
+    bool                                     itemsIndexed;
+
+    void IndexItemsByGroup() {
+        itemsByGroup.clear();
+        for(int i = 0; i < request.n; i++) {
+            itemsByGroup[request.elem[i].group.v].request.push_back(i);
+        }
+        for(int i = 0; i < constraint.n; i++) {
+            itemsByGroup[constraint.elem[i].group.v].constraint.push_back(i);
+        }
+        itemsIndexed = true;
+    }
+    void ForgetItemsByGroup() {
+        itemsByGroup.clear();
+        itemsIndexed = false;
+    }
+    GroupItems ItemsInGroup(hGroup h) {
+        GroupItems items = {};
+        if(itemsIndexed) {
+            auto it = itemsByGroup.find(h.v);
+            if(it != itemsByGroup.end()) items = it->second;
+            return items;
+        }
+        for(int i = 0; i < request.n; i++) {
+            if(request.elem[i].group.v == h.v) items.request.push_back(i);
+        }
+        for(int i = 0; i < constraint.n; i++) {
+            if(constraint.elem[i].group.v == h.v) items.constraint.push_back(i);
+        }
+        return items;
+    }
+
     void Clear();
 
     BBox CalculateEntityBBox(bool includingInvisible);
@@ -606,7 +825,7 @@ public:
         List<hGroup>                    groupOrder;
         IdList<Request,hRequest>        request;
         IdList<Constraint,hConstraint>  constraint;
-        IdList<Param,hParam>            param;
+        ParamList                       param;
         IdList<Style,hStyle>            style;
         hGroup                          activeGroup;
 
@@ -659,6 +878,7 @@ public:
     bool     drawBackFaces;
     bool     showContourAreas;
     bool     checkClosedContour;
+    bool     regenCache;
     bool     showToolbar;
     Platform::Path screenshotFile;
     RgbaColor backgroundColor;
@@ -756,6 +976,11 @@ public:
     bool LoadEntitiesFromFile(const Platform::Path &filename, EntityList *le,
                               SMesh *m, SShell *sh);
     bool ReloadAllLinked(const Platform::Path &filename, bool canCancel = false);
+    // The Boolean results for a sketch, kept beside it to open it faster.
+    Platform::Path RegenCacheFor(const Platform::Path &filename);
+    void SaveRegenCache(const Platform::Path &filename);
+    bool LoadRegenCache(const Platform::Path &filename);
+    void ForgetCachedShells();
     // And the various export options
     void ExportAsPngTo(const Platform::Path &filename);
     void ExportMeshTo(const Platform::Path &filename);
@@ -807,7 +1032,7 @@ public:
     };
     Clipboard clipboard;
 
-    void MarkGroupDirty(hGroup hg, bool onlyThis = false);
+    void MarkGroupDirty(hGroup hg);
     void MarkGroupDirtyByEntity(hEntity he);
 
     // Consistency checking on the sketch: stuff with missing dependencies
@@ -834,8 +1059,20 @@ public:
         UNTIL_ACTIVE,
     };
 
-    void GenerateAll(Generate type = Generate::DIRTY, bool andFindFree = false,
-                     bool genForBBox = false);
+    void GenerateAll(Generate type = Generate::DIRTY, bool andFindFree = false);
+    // A slow regeneration for display may be stopped early with the Esc key,
+    // or by CancelGenerate(); a cancel stops the regeneration that's running,
+    // or if none is, the next one to start. Every group then keeps the solid
+    // model that it had before, and is left dirty. GenerateAll() hands the
+    // solver and the shell code a CancelToken for this.
+    std::atomic<bool> generateCancelled;
+    void CancelGenerate();
+    // The Esc key that stops a regeneration is queued as a keypress too, and
+    // that arrives once we're back in the event loop; this says whether an
+    // Esc that arrives now is that one, or one of its repeats.
+    int64_t escapeStoppedGenerateAt;
+    bool EscapeStoppedGenerate();
+    bool GroupDependsOn(Group *g, const std::unordered_set<uint32_t> &groups);
     void SolveGroup(hGroup hg, bool andFindFree);
     void SolveGroupAndReport(hGroup hg, bool andFindFree);
     SolveResult TestRankForGroup(hGroup hg);
@@ -888,7 +1125,13 @@ void ImportDxf(const Platform::Path &file);
 void ImportDwg(const Platform::Path &file);
 
 extern SolveSpaceUI SS;
+#ifdef LIBRARY
+// The library builds the sketch from scratch for each solve, in the thread
+// that asked for it; so each thread has its own, and may solve concurrently.
+extern thread_local Sketch SK;
+#else
 extern Sketch SK;
+#endif
 
 }
 
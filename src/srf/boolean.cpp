@@ -8,12 +8,12 @@
 
 static int I;
 
-void SShell::MakeFromUnionOf(SShell *a, SShell *b) {
-    MakeFromBoolean(a, b, SSurface::CombineAs::UNION);
+void SShell::MakeFromUnionOf(SShell *a, SShell *b, const CancelToken &cancel) {
+    MakeFromBoolean(a, b, SSurface::CombineAs::UNION, cancel);
 }
 
-void SShell::MakeFromDifferenceOf(SShell *a, SShell *b) {
-    MakeFromBoolean(a, b, SSurface::CombineAs::DIFFERENCE);
+void SShell::MakeFromDifferenceOf(SShell *a, SShell *b, const CancelToken &cancel) {
+    MakeFromBoolean(a, b, SSurface::CombineAs::DIFFERENCE, cancel);
 }
 
 //-----------------------------------------------------------------------------
@@ -604,9 +604,11 @@ SSurface SSurface::MakeCopyTrimAgainst(SShell *parent,
     return ret;
 }
 
-void SShell::CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSurface::CombineAs type) {
+void SShell::CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSurface::CombineAs type,
+                                     const CancelToken &cancel) {
     SSurface *ss;
     for(ss = surface.First(); ss; ss = surface.NextAfter(ss)) {
+        if(cancel.Requested()) break;
         SSurface ssn;
         ssn = ss->MakeCopyTrimAgainst(this, sha, shb, into, type);
         ss->newH = into->surface.AddAndAssignId(&ssn);
@@ -614,9 +616,11 @@ void SShell::CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSu
     }
 }
 
-void SShell::MakeIntersectionCurvesAgainst(SShell *agnst, SShell *into) {
+void SShell::MakeIntersectionCurvesAgainst(SShell *agnst, SShell *into,
+                                           const CancelToken &cancel) {
     SSurface *sa;
     for(sa = surface.First(); sa; sa = surface.NextAfter(sa)) {
+        if(cancel.Requested()) break;
         SSurface *sb;
         for(sb = agnst->surface.First(); sb; sb = agnst->surface.NextAfter(sb)){
             // Intersect every surface from our shell against every surface
@@ -699,7 +703,8 @@ void SShell::MakeFromAssemblyOf(SShell *a, SShell *b) {
     RewriteSurfaceHandlesForCurves(a, b);
 }
 
-void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
+void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type,
+                             const CancelToken &cancel) {
     booleanFailed = false;
 
     a->MakeClassifyingBsps(NULL);
@@ -713,7 +718,14 @@ void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
 
     // Generate the intersection curves for each surface in A against all
     // the surfaces in B (which is all of the intersection curves).
-    a->MakeIntersectionCurvesAgainst(b, this);
+    a->MakeIntersectionCurvesAgainst(b, this, cancel);
+    if(cancel.Requested()) {
+        // We were asked to stop, and a partial result is no use to anyone.
+        a->CleanupAfterBoolean();
+        b->CleanupAfterBoolean();
+        Clear();
+        return;
+    }
 
     SCurve *sc;
     for(sc = curve.First(); sc; sc = curve.NextAfter(sc)) {
@@ -737,8 +749,14 @@ void SShell::MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type) {
         I = 0;
     }
     // Then trim and copy the surfaces
-    a->CopySurfacesTrimAgainst(a, b, this, type);
-    b->CopySurfacesTrimAgainst(a, b, this, type);
+    a->CopySurfacesTrimAgainst(a, b, this, type, cancel);
+    b->CopySurfacesTrimAgainst(a, b, this, type, cancel);
+    if(cancel.Requested()) {
+        a->CleanupAfterBoolean();
+        b->CleanupAfterBoolean();
+        Clear();
+        return;
+    }
 
     // Now that we've copied the surfaces, we know their new hSurfaces, so
     // rewrite the curves to refer to the surfaces by their handles in the
@@ -869,9 +869,10 @@ void SShell::MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierLis
     }
 }
 
-void SShell::TriangulateInto(SMesh *sm) {
+void SShell::TriangulateInto(SMesh *sm, const CancelToken &cancel) {
     SSurface *s;
     for(s = surface.First(); s; s = surface.NextAfter(s)) {
+        if(cancel.Requested()) break;
         s->TriangulateInto(this, sm);
     }
 }
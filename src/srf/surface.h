@@ -379,12 +379,16 @@ public:
     void MakeFromRevolutionOf(SBezierLoopSet *sbls, Vector pt, Vector axis,
                               RgbaColor color, Group *group);
 
-    void MakeFromUnionOf(SShell *a, SShell *b);
-    void MakeFromDifferenceOf(SShell *a, SShell *b);
-    void MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type);
+    // A Boolean that's cancelled partway leaves this shell empty.
+    void MakeFromUnionOf(SShell *a, SShell *b, const CancelToken &cancel = {});
+    void MakeFromDifferenceOf(SShell *a, SShell *b, const CancelToken &cancel = {});
+    void MakeFromBoolean(SShell *a, SShell *b, SSurface::CombineAs type,
+                         const CancelToken &cancel);
     void CopyCurvesSplitAgainst(bool opA, SShell *agnst, SShell *into);
-    void CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSurface::CombineAs type);
-    void MakeIntersectionCurvesAgainst(SShell *against, SShell *into);
+    void CopySurfacesTrimAgainst(SShell *sha, SShell *shb, SShell *into, SSurface::CombineAs type,
+                                 const CancelToken &cancel);
+    void MakeIntersectionCurvesAgainst(SShell *against, SShell *into,
+                                       const CancelToken &cancel);
     void MakeClassifyingBsps(SShell *useCurvesFrom);
     void AllPointsIntersecting(Vector a, Vector b, List<SInter> *il,
                                 bool asSegment, bool trimmed, bool inclTangent);
@@ -417,7 +421,8 @@ public:
     void MakeFromAssemblyOf(SShell *a, SShell *b);
     void MergeCoincidentSurfaces();
 
-    void TriangulateInto(SMesh *sm);
+    // A cancelled triangulation leaves sm with only some of the surfaces.
+    void TriangulateInto(SMesh *sm, const CancelToken &cancel = {});
     void MakeEdgesInto(SEdgeList *sel);
     void MakeSectionEdgesInto(Vector n, double d, SEdgeList *sel, SBezierList *sbl);
     bool IsEmpty() const;
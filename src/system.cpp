@@ -19,59 +19,135 @@ const double System::RANK_MAG_TOLERANCE = 1e-4;
 // always be much less than LENGTH_EPS, and in practice should be much less.
 const double System::CONVERGE_TOLERANCE = (LENGTH_EPS/(1e2));
 
-bool System::WriteJacobian(int tag) {
-    int a, i, j;
+// Solving the blocks on worker threads has a fixed cost, that only pays for
+// itself once the blocks have a few thousand Jacobian entries between them.
+const size_t System::PARALLEL_MIN_ENTRIES = 2000;
+
+// For timing the stages of a solve; GetMilliseconds() is too coarse.
+static double Milliseconds() {
+    auto timestamp = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double, std::milli>(timestamp).count();
+}
 
-    j = 0;
-    for(a = 0; a < param.n; a++) {
-        if(j >= MAX_UNKNOWNS) return false;
+static double SumOfSquares(const std::vector<double> &v) {
+    double sum = 0;
+    for(double x : v) sum += x*x;
+    return sum;
+}
 
+void System::WriteJacobian(int tag, Jacobian *J) {
+    // The column for each param in our table, or -1 if it's not an unknown
+    // in this subsystem. Those take the first slots in the values, in the
+    // same order, so that the unknowns are contiguous there.
+    std::vector<int> column(param.n, -1);
+    J->param.clear();
+    J->values.Clear();
+    for(int a = 0; a < param.n; a++) {
         Param *p = &(param.elem[a]);
         if(p->tag != tag) continue;
-        mat.param[j] = p->h;
-        j++;
+        column[a] = (int)J->param.size();
+        J->param.push_back(p->h);
+        J->values.SlotFor(p);
     }
-    mat.n = j;
-
-    i = 0;
-    for(a = 0; a < eq.n; a++) {
-        if(i >= MAX_UNKNOWNS) return false;
-
+    J->n = (int)J->param.size();
+    J->partials = partials;
+    J->cancel = cancel.flag;
+    J->leastSquares = leastSquares;
+    J->ldlRows.clear();
+
+    J->eq.clear();
+    J->A.start.clear();
+    J->A.col.clear();
+    J->A.sym.Clear();
+    J->B.sym.Clear();
+    J->load.start.clear();
+    J->load.reg.clear();
+    J->load.entry.clear();
+
+    J->iterations = 0;
+    J->rankTests = 0;
+    J->initialResidual = J->finalResidual = 0;
+    J->newtonMs = J->rankMs = 0;
+
+    std::vector<hParam> paramsUsed;
+    std::vector<std::pair<int, Expr *>> row;
+    for(int a = 0; a < eq.n; a++) {
         Equation *e = &(eq.elem[a]);
         if(e->tag != tag) continue;
 
-        mat.eq[i] = e->h;
+        J->eq.push_back(e->h);
+        J->A.start.push_back((int)J->A.col.size());
         Expr *f = e->e->DeepCopyWithParamsAsPointers(&param, &(SK.param));
         f = f->FoldConstants();
 
-        // Hash table (61 bits) to accelerate generation of zero partials.
-        uint64_t scoreboard = f->ParamsUsed();
-        for(j = 0; j < mat.n; j++) {
-            Expr *pd;
-            if(scoreboard & ((uint64_t)1 << (mat.param[j].v % 61)) &&
-                f->DependsOn(mat.param[j]))
-            {
-                pd = f->PartialWrt(mat.param[j]);
-                pd = pd->FoldConstants();
-                pd = pd->DeepCopyWithParamsAsPointers(&param, &(SK.param));
-            } else {
-                pd = Expr::From(0.0);
+        // Only the params that actually appear in the equation can have
+        // a nonzero partial, so those are the only entries we write.
+        paramsUsed.clear();
+        f->ParamsUsedList(&paramsUsed);
+        row.clear();
+        for(hParam hp : paramsUsed) {
+            int i = param.IndexOf(hp);
+            if(i < 0 || column[i] < 0) continue;
+
+            if(partials == Partials::AUTODIFF) {
+                row.emplace_back(column[i], (Expr *)NULL);
+                continue;
+            }
+            Expr *pd = f->PartialWrt(hp);
+            pd = pd->FoldConstants();
+            if(pd->op == Expr::Op::CONSTANT && EXACT(pd->v == 0.0)) continue;
+            pd = pd->DeepCopyWithParamsAsPointers(&param, &(SK.param));
+            row.emplace_back(column[i], pd);
+        }
+        std::sort(row.begin(), row.end(),
+            [](const std::pair<int, Expr *> &x, const std::pair<int, Expr *> &y) {
+                return x.first < y.first;
+            });
+        for(auto &entry : row) {
+            J->A.col.push_back(entry.first);
+            if(entry.second) J->A.sym.Add(entry.second, &J->values);
+        }
+        size_t k = J->B.sym.Add(f, &J->values);
+
+        if(partials == Partials::AUTODIFF) {
+            int rowStart = J->A.start.back();
+            int rowEnd   = (int)J->A.col.size();
+            J->load.start.push_back((int)J->load.reg.size());
+            for(size_t c = J->B.sym.codeStart[k]; c < J->B.sym.code.size(); c++) {
+                const ExprTape::Instr &in = J->B.sym.code[c];
+                if(in.op != Expr::Op::PARAM_PTR || (int)in.a >= J->n) continue;
+
+                for(int j = rowStart; j < rowEnd; j++) {
+                    if(J->A.col[j] != (int)in.a) continue;
+                    J->load.reg.push_back(in.r);
+                    J->load.entry.push_back(j);
+                    break;
+                }
             }
-            mat.A.sym[i][j] = pd;
         }
-        mat.B.sym[i] = f;
-        i++;
     }
-    mat.m = i;
-
-    return true;
+    J->m = (int)J->eq.size();
+    J->A.start.push_back((int)J->A.col.size());
+    J->load.start.push_back((int)J->load.reg.size());
+    J->A.num.resize(J->A.col.size());
+    J->B.num.resize(J->m);
+    J->values.Gather();
 }
 
-void System::EvalJacobian() {
-    int i, j;
-    for(i = 0; i < mat.m; i++) {
-        for(j = 0; j < mat.n; j++) {
-            mat.A.num[i][j] = (mat.A.sym[i][j])->Eval();
+void System::EvalJacobian(Jacobian *J) {
+    if(J->partials == Partials::SYMBOLIC) {
+        J->A.sym.Eval(J->values.val.data(), J->A.num.data());
+        return;
+    }
+
+    // Evaluate the residuals, and then sweep back over each one's code to
+    // get all the partials in its row at once.
+    J->B.sym.Eval(J->values.val.data(), J->B.num.data());
+    std::fill(J->A.num.begin(), J->A.num.end(), 0.0);
+    for(int i = 0; i < J->m; i++) {
+        J->B.sym.Adjoint(i);
+        for(int l = J->load.start[i]; l < J->load.start[i + 1]; l++) {
+            J->A.num[J->load.entry[l]] += J->B.sym.adj[J->load.reg[l]];
         }
     }
 }
@@ -113,7 +189,7 @@ void System::SolveBySubstitution() {
             int j;
             for(j = 0; j < eq.n; j++) {
                 Equation *req = &(eq.elem[j]);
-                (req->e)->Substitute(a, b); // A becomes B, B unchanged
+                req->e = (req->e)->Substitute(a, b); // A becomes B, B unchanged
             }
             for(j = 0; j < param.n; j++) {
                 Param *rp = &(param.elem[j]);
@@ -130,59 +206,187 @@ void System::SolveBySubstitution() {
     }
 }
 
+//-----------------------------------------------------------------------------
+// Split the equations and unknowns with tag zero in to blocks, such that no
+// equation references unknowns from more than one block; those blocks are
+// independent, so each can be solved on its own, and the small systems are
+// much cheaper to solve than one big one. These are the connected components
+// of the graph with an edge between each equation and the unknowns that it
+// references. An unknown that no equation references is in no block, and
+// keeps tag zero.
+//-----------------------------------------------------------------------------
+void System::FindBlocks(int firstTag) {
+    // Union-find over the unknowns, by their index in our param table.
+    std::vector<int> parent(param.n);
+    for(int i = 0; i < param.n; i++) {
+        parent[i] = i;
+    }
+    auto root = [&](int i) {
+        while(parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+
+    std::vector<int> eqParam(eq.n, -1);
+    std::vector<hParam> paramsUsed;
+    for(int a = 0; a < eq.n; a++) {
+        Equation *e = &(eq.elem[a]);
+        if(e->tag != 0) continue;
+
+        paramsUsed.clear();
+        e->e->ParamsUsedList(&paramsUsed);
+        for(hParam hp : paramsUsed) {
+            int i = param.IndexOf(hp);
+            if(i < 0 || param.elem[i].tag != 0) continue;
+
+            if(eqParam[a] < 0) {
+                eqParam[a] = i;
+            } else {
+                int ra = root(eqParam[a]), ri = root(i);
+                if(ra != ri) parent[ri] = ra;
+            }
+        }
+    }
+
+    // Number the blocks in the order of their first equation, so that the
+    // order in which they're solved is deterministic. An equation that
+    // references no unknowns is a block by itself; it's either satisfied
+    // already, or inconsistent.
+    std::vector<int> blockOf(param.n, -1);
+    firstBlock = firstTag;
+    blocks = 0;
+    for(int a = 0; a < eq.n; a++) {
+        Equation *e = &(eq.elem[a]);
+        if(e->tag != 0) continue;
+
+        if(eqParam[a] < 0) {
+            e->tag = firstBlock + (blocks++);
+            continue;
+        }
+        int r = root(eqParam[a]);
+        if(blockOf[r] < 0) blockOf[r] = blocks++;
+        e->tag = firstBlock + blockOf[r];
+    }
+    for(int i = 0; i < param.n; i++) {
+        Param *p = &(param.elem[i]);
+        if(p->tag != 0) continue;
+
+        int b = blockOf[root(i)];
+        if(b >= 0) p->tag = firstBlock + b;
+    }
+}
+
+bool System::IsBlockTag(int tag) const {
+    return tag >= firstBlock && tag < firstBlock + blocks;
+}
+
 //-----------------------------------------------------------------------------
 // Calculate the rank of the Jacobian matrix, by Gram-Schimdt orthogonalization
-// in place. A row (~equation) is considered to be all zeros if its magnitude
-// is less than the tolerance RANK_MAG_TOLERANCE.
+// of its rows. A row (~equation) is considered to be all zeros if its magnitude
+// is less than the tolerance RANK_MAG_TOLERANCE. The Jacobian itself is left
+// untouched; the orthogonalized rows are kept sparse, and each row is only
+// projected onto the previous rows that share a column with it, since its
+// component in the direction of any other row is zero.
 //-----------------------------------------------------------------------------
-int System::CalculateRank() {
+int System::CalculateRank(Jacobian *J, std::vector<bool> *independent) {
+    double startMs = Milliseconds();
     // Actually work with magnitudes squared, not the magnitudes
-    double rowMag[MAX_UNKNOWNS] = {};
     double tol = RANK_MAG_TOLERANCE*RANK_MAG_TOLERANCE;
 
-    int i, iprev, j;
+    std::vector<std::vector<std::pair<int, double>>> rows(J->m);
+    std::vector<double> rowMag(J->m);
+    // For each column, the (nonzero) orthogonalized rows that touch it
+    std::vector<std::vector<int>> colRows(J->n);
+    // The row being orthogonalized, scattered into a dense vector
+    std::vector<double> dense(J->n, 0.0);
+    std::vector<bool> touched(J->n, false);
+    std::vector<int> touchedCols;
+    std::vector<int> lastSeen(J->m, -1);
+    std::vector<int> prevRows;
+
+    int i, k;
     int rank = 0;
 
-    for(i = 0; i < mat.m; i++) {
+    for(i = 0; i < J->m; i++) {
+        if(J->cancel != NULL && J->cancel->load(std::memory_order_relaxed)) {
+            // The rank doesn't matter, since the solve stops; but our caller
+            // may still look at every row.
+            if(independent) independent->resize(J->m, false);
+            break;
+        }
+        touchedCols.clear();
+        prevRows.clear();
+        for(k = J->A.start[i]; k < J->A.start[i+1]; k++) {
+            int c = J->A.col[k];
+            dense[c] = J->A.num[k];
+            touched[c] = true;
+            touchedCols.push_back(c);
+            for(int iprev : colRows[c]) {
+                if(lastSeen[iprev] == i) continue;
+                lastSeen[iprev] = i;
+                prevRows.push_back(iprev);
+            }
+        }
+        std::sort(prevRows.begin(), prevRows.end());
+
         // Subtract off this row's component in the direction of any
         // previous rows
-        for(iprev = 0; iprev < i; iprev++) {
-            if(rowMag[iprev] <= tol) continue; // ignore zero rows
-
+        for(int iprev : prevRows) {
             double dot = 0;
-            for(j = 0; j < mat.n; j++) {
-                dot += (mat.A.num[iprev][j]) * (mat.A.num[i][j]);
+            for(const auto &e : rows[iprev]) {
+                dot += e.second * dense[e.first];
             }
-            for(j = 0; j < mat.n; j++) {
-                mat.A.num[i][j] -= (dot/rowMag[iprev])*mat.A.num[iprev][j];
+            for(const auto &e : rows[iprev]) {
+                dense[e.first] -= (dot/rowMag[iprev])*e.second;
+                if(!touched[e.first]) {
+                    touched[e.first] = true;
+                    touchedCols.push_back(e.first);
+                }
             }
         }
         // Our row is now normal to all previous rows; calculate the
         // magnitude of what's left
+        std::sort(touchedCols.begin(), touchedCols.end());
         double mag = 0;
-        for(j = 0; j < mat.n; j++) {
-            mag += (mat.A.num[i][j]) * (mat.A.num[i][j]);
+        for(int c : touchedCols) {
+            mag += dense[c] * dense[c];
         }
+        if(independent) independent->push_back(mag > tol);
         if(mag > tol) {
             rank++;
+            // Only rows that aren't zero need to be kept, since zero rows
+            // are ignored when orthogonalizing the ones after.
+            for(int c : touchedCols) {
+                if(EXACT(dense[c] == 0.0)) continue;
+                rows[i].emplace_back(c, dense[c]);
+                colRows[c].push_back(i);
+            }
         }
         rowMag[i] = mag;
+
+        for(int c : touchedCols) {
+            dense[c] = 0;
+            touched[c] = false;
+        }
     }
 
+    J->rankTests++;
+    J->rankMs += Milliseconds() - startMs;
     return rank;
 }
 
-bool System::TestRank() {
-    EvalJacobian();
-    return CalculateRank() == mat.m;
+bool System::TestRank(Jacobian *J) {
+    EvalJacobian(J);
+    return CalculateRank(J) == J->m;
 }
 
-bool System::SolveLinearSystem(double X[], double A[][MAX_UNKNOWNS],
-                               double B[], int n)
+bool System::SolveLinearSystem(double X[], double A[], double B[], int n)
 {
     // Gaussian elimination, with partial pivoting. It's an error if the
     // matrix is singular, because that means two constraints are
-    // equivalent.
+    // equivalent. The matrix is n by n, stored by rows.
     int i, j, ip, jp, imax = 0;
     double max, temp;
 
@@ -191,9 +395,9 @@ bool System::SolveLinearSystem(double X[], double A[][MAX_UNKNOWNS],
         // greater. First, find a pivot (between rows i and N-1).
         max = 0;
         for(ip = i; ip < n; ip++) {
-            if(ffabs(A[ip][i]) > max) {
+            if(ffabs(A[ip*n + i]) > max) {
                 imax = ip;
-                max = ffabs(A[ip][i]);
+                max = ffabs(A[ip*n + i]);
             }
         }
         // Don't give up on a singular matrix unless it's really bad; the
@@ -203,16 +407,16 @@ bool System::SolveLinearSystem(double X[], double A[][MAX_UNKNOWNS],
 
         // Swap row imax with row i
         for(jp = 0; jp < n; jp++) {
-            swap(A[i][jp], A[imax][jp]);
+            swap(A[i*n + jp], A[imax*n + jp]);
         }
         swap(B[i], B[imax]);
 
         // For rows i+1 and greater, eliminate the term in column i.
         for(ip = i+1; ip < n; ip++) {
-            temp = A[ip][i]/A[i][i];
+            temp = A[ip*n + i]/A[i*n + i];
 
             for(jp = i; jp < n; jp++) {
-                A[ip][jp] -= temp*(A[i][jp]);
+                A[ip*n + jp] -= temp*(A[i*n + jp]);
             }
             B[ip] -= temp*B[i];
         }
@@ -221,114 +425,367 @@ bool System::SolveLinearSystem(double X[], double A[][MAX_UNKNOWNS],
     // We've put the matrix in upper triangular form, so at this point we
     // can solve by back-substitution.
     for(i = n - 1; i >= 0; i--) {
-        if(ffabs(A[i][i]) < 1e-20) continue;
+        if(ffabs(A[i*n + i]) < 1e-20) continue;
 
         temp = B[i];
         for(j = n - 1; j > i; j--) {
-            temp -= X[j]*A[i][j];
+            temp -= X[j]*A[i*n + j];
         }
-        X[i] = temp / A[i][i];
+        X[i] = temp / A[i*n + i];
     }
 
     return true;
 }
 
-bool System::SolveLeastSquares() {
-    int r, c, i;
+//-----------------------------------------------------------------------------
+// Order the rows and columns of a symmetric matrix, given the off-diagonal
+// nonzeros in each row, so that it fills in little when factored. This is
+// plain minimum degree: eliminate the node with the fewest neighbours, join
+// those neighbours up, and repeat. Ties go to the lowest index, so the order
+// is deterministic.
+//-----------------------------------------------------------------------------
+void System::MinimumDegreeOrder(const std::vector<std::vector<int>> &adj,
+                                std::vector<int> *perm)
+{
+    int n = (int)adj.size();
+    std::vector<std::set<int>> g(n);
+    std::set<std::pair<int, int>> byDegree;
+    for(int i = 0; i < n; i++) {
+        g[i].insert(adj[i].begin(), adj[i].end());
+        byDegree.emplace((int)g[i].size(), i);
+    }
+
+    perm->clear();
+    std::vector<int> nbr;
+    while(!byDegree.empty()) {
+        int v = byDegree.begin()->second;
+        byDegree.erase(byDegree.begin());
+        perm->push_back(v);
+
+        nbr.assign(g[v].begin(), g[v].end());
+        for(int u : nbr) {
+            byDegree.erase({ (int)g[u].size(), u });
+            g[u].erase(v);
+            for(int w : nbr) {
+                if(w != u) g[u].insert(w);
+            }
+            byDegree.emplace((int)g[u].size(), u);
+        }
+        g[v].clear();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// The symbolic factorization: the permuted matrix's upper triangle, the
+// elimination tree, and the number of nonzeros in each column of L. This is
+// the up-looking LDL' of T. Davis, "Algorithm 849: A concise sparse Cholesky
+// factorization package".
+//-----------------------------------------------------------------------------
+void System::SparseLDL::Analyze(int nn, const std::vector<std::vector<int>> &adj) {
+    n = nn;
+    MinimumDegreeOrder(adj, &perm);
+    std::vector<int> pinv(n);
+    for(int k = 0; k < n; k++) pinv[perm[k]] = k;
+
+    Ap.assign(1, 0);
+    Ai.clear();
+    for(int k = 0; k < n; k++) {
+        for(int j : adj[perm[k]]) {
+            if(pinv[j] < k) Ai.push_back(pinv[j]);
+        }
+        Ai.push_back(k);
+        Ap.push_back((int)Ai.size());
+    }
+    Ax.resize(Ai.size());
+
+    std::vector<int> flag(n), lnz(n);
+    parent.assign(n, -1);
+    for(int k = 0; k < n; k++) {
+        flag[k] = k;
+        lnz[k] = 0;
+        for(int p = Ap[k]; p < Ap[k+1]; p++) {
+            // Follow the path from i to the root of the elimination tree,
+            // stopping at the first node already flagged for this column.
+            for(int i = Ai[p]; flag[i] != k; i = parent[i]) {
+                if(parent[i] == -1) parent[i] = k;
+                lnz[i]++;
+                flag[i] = k;
+            }
+        }
+    }
+    Lp.resize(n + 1);
+    Lp[0] = 0;
+    for(int k = 0; k < n; k++) Lp[k+1] = Lp[k] + lnz[k];
+    Li.resize(Lp[n]);
+    Lx.resize(Lp[n]);
+    D.resize(n);
+    zero.resize(n);
+}
+
+//-----------------------------------------------------------------------------
+// The numeric factorization of the values now in Ax. A pivot that's zero
+// means the matrix is singular, as happens with redundant constraints; like
+// the dense elimination, we don't give up, and just skip that pivot.
+//-----------------------------------------------------------------------------
+void System::SparseLDL::Factor() {
+    std::vector<double> y(n, 0.0);
+    std::vector<int> pattern(n), flag(n), lnz(n);
+    for(int k = 0; k < n; k++) {
+        // Scatter column k, and find the nonzero pattern of row k of L from
+        // the elimination tree, in topological order.
+        int top = n;
+        flag[k] = k;
+        lnz[k] = 0;
+        for(int p = Ap[k]; p < Ap[k+1]; p++) {
+            int i = Ai[p];
+            y[i] += Ax[p];
+            int len = 0;
+            for(; flag[i] != k; i = parent[i]) {
+                pattern[len++] = i;
+                flag[i] = k;
+            }
+            while(len > 0) pattern[--top] = pattern[--len];
+        }
+
+        // Solve for row k of L, and the pivot
+        D[k] = y[k];
+        y[k] = 0.0;
+        for(; top < n; top++) {
+            int i = pattern[top];
+            double yi = y[i];
+            y[i] = 0.0;
+            int p2 = Lp[i] + lnz[i];
+            for(int p = Lp[i]; p < p2; p++) {
+                y[Li[p]] -= Lx[p]*yi;
+            }
+            double lki = zero[i] ? 0.0 : yi/D[i];
+            D[k] -= lki*yi;
+            Li[p2] = k;
+            Lx[p2] = lki;
+            lnz[i]++;
+        }
+        zero[k] = (ffabs(D[k]) < 1e-20);
+    }
+}
+
+void System::SparseLDL::Solve(double *x) const {
+    std::vector<double> y(n);
+    int j, p;
+    for(j = 0; j < n; j++) y[j] = x[perm[j]];
+    for(j = 0; j < n; j++) {
+        for(p = Lp[j]; p < Lp[j+1]; p++) {
+            y[Li[p]] -= Lx[p]*y[j];
+        }
+    }
+    for(j = 0; j < n; j++) {
+        y[j] = zero[j] ? 0.0 : y[j]/D[j];
+    }
+    for(j = n - 1; j >= 0; j--) {
+        for(p = Lp[j]; p < Lp[j+1]; p++) {
+            y[j] -= Lx[p]*y[Li[p]];
+        }
+    }
+    for(j = 0; j < n; j++) x[perm[j]] = y[j];
+}
+
+void System::AnalyzeLeastSquares(Jacobian *J) {
+    // Two rows of A*A' interact only if those rows of A share a column.
+    std::vector<std::vector<int>> colRows(J->n);
+    int r, j;
+    for(r = 0; r < J->m; r++) {
+        for(j = J->A.start[r]; j < J->A.start[r+1]; j++) {
+            colRows[J->A.col[j]].push_back(r);
+        }
+    }
+    std::vector<std::vector<int>> adj(J->m);
+    std::vector<int> mark(J->m, -1);
+    for(r = 0; r < J->m; r++) {
+        mark[r] = r;
+        for(j = J->A.start[r]; j < J->A.start[r+1]; j++) {
+            for(int r2 : colRows[J->A.col[j]]) {
+                if(mark[r2] == r) continue;
+                mark[r2] = r;
+                adj[r].push_back(r2);
+            }
+        }
+        std::sort(adj[r].begin(), adj[r].end());
+    }
+    J->ldl.Analyze(J->m, adj);
+
+    J->ldlRows.clear();
+    for(int k = 0; k < J->m; k++) {
+        for(int p = J->ldl.Ap[k]; p < J->ldl.Ap[k+1]; p++) {
+            J->ldlRows.emplace_back(J->ldl.perm[J->ldl.Ai[p]], J->ldl.perm[k]);
+        }
+    }
+}
+
+static double RowDot(System::Jacobian *J, int ra, int rb) {
+    // The rows' entries are sorted by column.
+    int ja = J->A.start[ra], jb = J->A.start[rb];
+    double dot = 0;
+    while(ja < J->A.start[ra+1] && jb < J->A.start[rb+1]) {
+        if(J->A.col[ja] < J->A.col[jb]) {
+            ja++;
+        } else if(J->A.col[ja] > J->A.col[jb]) {
+            jb++;
+        } else {
+            dot += J->A.num[ja++]*J->A.num[jb++];
+        }
+    }
+    return dot;
+}
+
+void System::FactorNormalEquations(Jacobian *J) {
+    if(J->ldlRows.size() < (size_t)J->m) AnalyzeLeastSquares(J);
+
+    // Each entry of A*A' is the dot product of two rows of A.
+    for(size_t k = 0; k < J->ldlRows.size(); k++) {
+        J->ldl.Ax[k] = RowDot(J, J->ldlRows[k].first, J->ldlRows[k].second);
+    }
+    J->ldl.Factor();
+}
+
+bool System::SolveLeastSquares(Jacobian *J) {
+    int r, c;
+    size_t k;
 
     // Scale the columns; this scale weights the parameters for the least
     // squares solve, so that we can encourage the solver to make bigger
     // changes in some parameters, and smaller in others.
-    for(c = 0; c < mat.n; c++) {
-        if(IsDragged(mat.param[c])) {
+    J->scale.resize(J->n);
+    for(c = 0; c < J->n; c++) {
+        if(IsDragged(J->param[c])) {
             // It's least squares, so this parameter doesn't need to be all
             // that big to get a large effect.
-            mat.scale[c] = 1/20.0;
+            J->scale[c] = 1/20.0;
         } else {
-            mat.scale[c] = 1;
-        }
-        for(r = 0; r < mat.m; r++) {
-            mat.A.num[r][c] *= mat.scale[c];
+            J->scale[c] = 1;
         }
     }
+    for(k = 0; k < J->A.num.size(); k++) {
+        J->A.num[k] *= J->scale[J->A.col[k]];
+    }
 
-    // Write A*A'
-    for(r = 0; r < mat.m; r++) {
-        for(c = 0; c < mat.m; c++) {  // yes, AAt is square
-            double sum = 0;
-            for(i = 0; i < mat.n; i++) {
-                sum += mat.A.num[r][i]*mat.A.num[c][i];
+    if(J->leastSquares == LeastSquares::SPARSE) {
+        FactorNormalEquations(J);
+        J->Z = J->B.num;
+        J->ldl.Solve(J->Z.data());
+    } else {
+        // Write A*A'; only pairs of rows that share a column contribute, so
+        // go through the nonzeros column by column.
+        std::vector<std::vector<std::pair<int, double>>> colEntries(J->n);
+        for(r = 0; r < J->m; r++) {
+            for(int j = J->A.start[r]; j < J->A.start[r+1]; j++) {
+                colEntries[J->A.col[j]].emplace_back(r, J->A.num[j]);
+            }
+        }
+        J->AAt.assign((size_t)J->m * (size_t)J->m, 0.0);  // yes, AAt is square
+        for(c = 0; c < J->n; c++) {
+            for(const auto &er : colEntries[c]) {
+                for(const auto &ec : colEntries[c]) {
+                    J->AAt[(size_t)er.first * (size_t)J->m + (size_t)ec.first] +=
+                        er.second * ec.second;
+                }
             }
-            mat.AAt[r][c] = sum;
         }
-    }
 
-    if(!SolveLinearSystem(mat.Z, mat.AAt, mat.B.num, mat.m)) return false;
+        J->Z.assign(J->m, 0.0);
+        if(!SolveLinearSystem(J->Z.data(), J->AAt.data(), J->B.num.data(), J->m)) {
+            return false;
+        }
+    }
 
     // And multiply that by A' to get our solution.
-    for(c = 0; c < mat.n; c++) {
-        double sum = 0;
-        for(i = 0; i < mat.m; i++) {
-            sum += mat.A.num[i][c]*mat.Z[i];
+    J->X.assign(J->n, 0.0);
+    for(r = 0; r < J->m; r++) {
+        for(int j = J->A.start[r]; j < J->A.start[r+1]; j++) {
+            J->X[J->A.col[j]] += J->A.num[j]*J->Z[r];
         }
-        mat.X[c] = sum * mat.scale[c];
+    }
+    for(c = 0; c < J->n; c++) {
+        J->X[c] *= J->scale[c];
     }
     return true;
 }
 
-bool System::NewtonSolve(int tag) {
+bool System::NewtonSolve(Jacobian *J) {
+    double startMs = Milliseconds();
 
     int iter = 0;
-    bool converged = false;
+    bool converged = false, diverged = false;
     int i;
 
-    // Evaluate the functions at our operating point.
-    for(i = 0; i < mat.m; i++) {
-        mat.B.num[i] = (mat.B.sym[i])->Eval();
-    }
+    // Evaluate the functions at our operating point. The unknowns are stepped
+    // in their slots, and written back to the params once we're done.
+    double *x = J->values.val.data();
+    J->values.Gather();
+    J->B.sym.Eval(J->values.val.data(), J->B.num.data());
+    J->initialResidual = SumOfSquares(J->B.num);
+    J->iterations = 0;
     do {
+        if(Cancelled()) break;
+
         // And evaluate the Jacobian at our initial operating point.
-        EvalJacobian();
+        EvalJacobian(J);
 
-        if(!SolveLeastSquares()) break;
+        if(!SolveLeastSquares(J)) break;
+        J->iterations++;
 
         // Take the Newton step;
         //      J(x_n) (x_{n+1} - x_n) = 0 - F(x_n)
-        for(i = 0; i < mat.n; i++) {
-            Param *p = param.FindById(mat.param[i]);
-            p->val -= mat.X[i];
-            if(isnan(p->val)) {
+        for(i = 0; i < J->n; i++) {
+            x[i] -= J->X[i];
+        }
+        for(i = 0; i < J->n; i++) {
+            if(isnan(x[i])) {
                 // Very bad, and clearly not convergent
-                return false;
+                diverged = true;
+                break;
             }
         }
+        if(diverged) break;
 
         // Re-evalute the functions, since the params have just changed.
-        for(i = 0; i < mat.m; i++) {
-            mat.B.num[i] = (mat.B.sym[i])->Eval();
-        }
+        J->B.sym.Eval(J->values.val.data(), J->B.num.data());
         // Check for convergence
         converged = true;
-        for(i = 0; i < mat.m; i++) {
-            if(isnan(mat.B.num[i])) {
-                return false;
+        for(i = 0; i < J->m; i++) {
+            if(isnan(J->B.num[i])) {
+                diverged = true;
+                break;
             }
-            if(ffabs(mat.B.num[i]) > CONVERGE_TOLERANCE) {
+            if(ffabs(J->B.num[i]) > CONVERGE_TOLERANCE) {
                 converged = false;
                 break;
             }
         }
+        if(diverged) {
+            converged = false;
+            break;
+        }
     } while(iter++ < 50 && !converged);
+    J->values.Scatter(J->n);
 
+    J->finalResidual = SumOfSquares(J->B.num);
+    J->newtonMs = Milliseconds() - startMs;
     return converged;
 }
 
+void System::CountStats(const Jacobian *J) {
+    stats.iterations      += J->iterations;
+    stats.rankTests       += J->rankTests;
+    stats.initialResidual += J->initialResidual;
+    stats.finalResidual   += J->finalResidual;
+    stats.newtonMs        += J->newtonMs;
+    stats.rankMs          += J->rankMs;
+}
+
 void System::WriteEquationsExceptFor(hConstraint hc, Group *g) {
     int i;
     // Generate all the equations from constraints in this group
-    for(i = 0; i < SK.constraint.n; i++) {
-        ConstraintBase *c = &(SK.constraint.elem[i]);
-        if(c->group.v != g->h.v) continue;
+    for(int k : SK.ItemsInGroup(g->h).constraint) {
+        ConstraintBase *c = &(SK.constraint.elem[k]);
         if(c->h.v == hc.v) continue;
 
         if(c->HasLabel() && c->type != Constraint::Type::COMMENT &&
@@ -359,13 +816,190 @@ void System::WriteEquationsExceptFor(hConstraint hc, Group *g) {
     g->GenerateEquations(&eq);
 }
 
+//-----------------------------------------------------------------------------
+// Find a basis for the left null space of the Jacobian, the combinations y
+// of its rows with y'*A = 0, using the rank test's tolerance. Each row that
+// depends on the rows before it, less its least squares projection on to
+// the independent rows, is one such combination.
+//-----------------------------------------------------------------------------
+void System::LeftNullSpace(Jacobian *J, std::vector<std::vector<double>> *null) {
+    std::vector<bool> independent;
+    CalculateRank(J, &independent);
+
+    Jacobian basis = {};
+    std::vector<int> basisRow;
+    basis.n = J->n;
+    basis.A.start.push_back(0);
+    for(int i = 0; i < J->m; i++) {
+        if(!independent[i]) continue;
+        basisRow.push_back(i);
+        for(int j = J->A.start[i]; j < J->A.start[i+1]; j++) {
+            basis.A.col.push_back(J->A.col[j]);
+            basis.A.num.push_back(J->A.num[j]);
+        }
+        basis.A.start.push_back((int)basis.A.col.size());
+    }
+    basis.m = (int)basisRow.size();
+    FactorNormalEquations(&basis);
+
+    std::vector<std::vector<int>> colRows(J->n);
+    for(int b = 0; b < basis.m; b++) {
+        for(int j = basis.A.start[b]; j < basis.A.start[b+1]; j++) {
+            colRows[basis.A.col[j]].push_back(b);
+        }
+    }
+
+    null->clear();
+    std::vector<double> z(basis.m);
+    std::vector<int> mark(basis.m, -1);
+    for(int i = 0; i < J->m; i++) {
+        if(independent[i]) continue;
+
+        std::fill(z.begin(), z.end(), 0.0);
+        for(int j = J->A.start[i]; j < J->A.start[i+1]; j++) {
+            for(int b : colRows[J->A.col[j]]) {
+                if(mark[b] == i) continue;
+                mark[b] = i;
+                z[b] = RowDot(J, basisRow[b], i);
+            }
+        }
+        basis.ldl.Solve(z.data());
+
+        std::vector<double> y(J->m, 0.0);
+        y[i] = 1;
+        for(int b = 0; b < basis.m; b++) {
+            y[basisRow[b]] = -z[b];
+        }
+        null->push_back(std::move(y));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Find the constraints that, if removed, would leave a Jacobian of full rank.
+// Rather than rewriting and testing the system once per constraint, we find
+// the left null space of the whole Jacobian. Removing some equations leaves
+// full rank exactly when no null combination survives without them, so when
+// the rows of the null space basis for those equations have full rank.
+//-----------------------------------------------------------------------------
 void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad, bool forceDofCheck) {
-    int a, i;
+    // The caller still needs the substitutions from its own solve.
+    std::vector<int> tags;
+    for(int i = 0; i < param.n; i++) tags.push_back(param.elem[i].tag);
+
+    param.ClearTags();
+    eq.Clear();
+    WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
+    eq.ClearTags();
+
+    // The Jacobian of all the equations, before any substitution; it's this
+    // that the constraints' rows are removed from.
+    Jacobian full = {};
+    WriteJacobian(0, &full);
+
+    // It's a major speedup to solve the easy ones by substitution here,
+    // and that doesn't change the rank. The null space is found after that,
+    // so that the rank test gives the same result as in the solve.
+    if(!forceDofCheck) {
+        SolveBySubstitution();
+    }
+    for(int i = 0; i < param.n; i++) {
+        Param *p = &(param.elem[i]);
+        if(p->tag == VAR_SUBSTITUTED) p->val = param.FindById(p->substd)->val;
+    }
+    WriteJacobian(0, &mat);
+    EvalJacobian(&mat);
+    // The substituted params have just taken new values.
+    full.values.Gather();
+    EvalJacobian(&full);
+
+    std::vector<std::vector<double>> null;
+    LeftNullSpace(&mat, &null);
+    size_t d = null.size();
+    stats.rankTests += mat.rankTests;
+    stats.rankMs += mat.rankMs;
+
+    // The rows of the full Jacobian that survived substitution are those of
+    // mat, in the same order; the rest are the substituted equations, a - b
+    // with a eliminated.
+    Jacobian subst = {};
+    std::vector<int> restRow, substRow;
+    subst.n = full.n;
+    subst.A.start.push_back(0);
+    for(int i = 0; i < full.m; i++) {
+        if(eq.FindById(full.eq[i])->tag != EQ_SUBSTITUTED) {
+            restRow.push_back(i);
+            continue;
+        }
+        substRow.push_back(i);
+        for(int j = full.A.start[i]; j < full.A.start[i+1]; j++) {
+            subst.A.col.push_back(full.A.col[j]);
+            subst.A.num.push_back(full.A.num[j]);
+        }
+        subst.A.start.push_back((int)subst.A.col.size());
+    }
+    subst.m = (int)substRow.size();
+    ssassert((int)restRow.size() == mat.m, "Unexpected rows after substitution");
+    if(subst.m > 0) FactorNormalEquations(&subst);
+
+    // So extend each null vector to those rows: with g = y'*A over the rows
+    // that survived, find the weights w of the substituted rows that cancel
+    // it, w'*S = -g. The substituted equations form a forest over the params,
+    // and g sums to zero over each tree, so the least squares w is exact.
+    std::vector<std::vector<double>> fullNull;
+    std::vector<double> gs(full.n), w(subst.m);
+    for(size_t k = 0; k < d; k++) {
+        std::vector<double> y(full.m, 0.0);
+        std::fill(gs.begin(), gs.end(), 0.0);
+        for(int r = 0; r < mat.m; r++) {
+            double yr = null[k][r];
+            y[restRow[r]] = yr;
+            if(yr == 0.0) continue;
+            for(int j = full.A.start[restRow[r]]; j < full.A.start[restRow[r]+1]; j++) {
+                gs[full.A.col[j]] += yr*full.A.num[j];
+            }
+        }
+        for(int r = 0; r < subst.m; r++) {
+            double dot = 0;
+            for(int j = subst.A.start[r]; j < subst.A.start[r+1]; j++) {
+                dot += subst.A.num[j]*gs[subst.A.col[j]];
+            }
+            w[r] = dot;
+        }
+        if(subst.m > 0) subst.ldl.Solve(w.data());
+        for(int r = 0; r < subst.m; r++) {
+            y[substRow[r]] = -w[r];
+        }
+
+        // Keep the basis orthonormal, so that its rows are comparable.
+        for(const std::vector<double> &v : fullNull) {
+            double dot = 0;
+            for(int r = 0; r < full.m; r++) dot += v[r]*y[r];
+            for(int r = 0; r < full.m; r++) y[r] -= dot*v[r];
+        }
+        double mag = 0;
+        for(int r = 0; r < full.m; r++) mag += y[r]*y[r];
+        mag = sqrt(mag);
+        for(int r = 0; r < full.m; r++) y[r] /= mag;
+        fullNull.push_back(std::move(y));
+    }
+
+    for(int i = 0; i < param.n; i++) param.elem[i].tag = tags[i];
+
+    // The rows that each constraint wrote
+    std::unordered_map<uint32_t, std::vector<int>> constraintRows;
+    for(int i = 0; i < full.m; i++) {
+        if(!full.eq[i].isFromConstraint()) continue;
+        constraintRows[full.eq[i].constraint().v].push_back(i);
+    }
 
-    for(a = 0; a < 2; a++) {
-        for(i = 0; i < SK.constraint.n; i++) {
+    double tol = RANK_MAG_TOLERANCE*RANK_MAG_TOLERANCE;
+    std::vector<std::vector<double>> sub;
+    std::vector<double> v;
+    std::vector<int> inGroup = SK.ItemsInGroup(g->h).constraint;
+    for(int a = 0; a < 2; a++) {
+        for(int i : inGroup) {
+            if(Cancelled()) return;
             ConstraintBase *c = &(SK.constraint.elem[i]);
-            if(c->group.v != g->h.v) continue;
             if((c->type == Constraint::Type::POINTS_COINCIDENT && a == 0) ||
                (c->type != Constraint::Type::POINTS_COINCIDENT && a == 1))
             {
@@ -375,24 +1009,54 @@ void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad, bo
                 continue;
             }
 
-            param.ClearTags();
-            eq.Clear();
-            WriteEquationsExceptFor(c->h, g);
-            eq.ClearTags();
-
-            // It's a major speedup to solve the easy ones by substitution here,
-            // and that doesn't break anything.
-            if(!forceDofCheck) {
-                SolveBySubstitution();
+            const std::vector<int> &rows = constraintRows[c->h.v];
+            if(rows.size() < d) continue;
+
+            // Test the rank of the null space basis, restricted to this
+            // constraint's rows, by Gram-Schmidt.
+            stats.rankTests++;
+            bool fullRank = true;
+            sub.clear();
+            for(size_t k = 0; k < d; k++) {
+                v.clear();
+                for(int r : rows) v.push_back(fullNull[k][r]);
+                for(const std::vector<double> &u : sub) {
+                    double dot = 0;
+                    for(size_t j = 0; j < v.size(); j++) dot += u[j]*v[j];
+                    for(size_t j = 0; j < v.size(); j++) v[j] -= dot*u[j];
+                }
+                double mag = 0;
+                for(double vj : v) mag += vj*vj;
+                if(mag <= tol) {
+                    fullRank = false;
+                    break;
+                }
+                mag = sqrt(mag);
+                for(double &vj : v) vj /= mag;
+                sub.push_back(v);
             }
+            if(fullRank) {
+                // We'd fix it by removing this constraint
+                bad->Add(&(c->h));
+            }
+        }
+    }
+}
 
-            WriteJacobian(0);
-            EvalJacobian();
+void System::AddUnsatisfiedConstraints(Jacobian *J, List<hConstraint> *bad) {
+    for(int i = 0; i < J->m; i++) {
+        if(ffabs(J->B.num[i]) > CONVERGE_TOLERANCE || isnan(J->B.num[i])) {
+            // This constraint is unsatisfied.
+            if(!J->eq[i].isFromConstraint()) continue;
 
-            int rank = CalculateRank();
-            if(rank == mat.m) {
-                // We fixed it by removing this constraint
+            hConstraint hc = J->eq[i].constraint();
+            ConstraintBase *c = SK.constraint.FindByIdNoOops(hc);
+            if(!c) continue;
+            // Don't double-show constraints that generated multiple
+            // unsatisfied equations
+            if(!c->tag) {
                 bad->Add(&(c->h));
+                c->tag = 1;
             }
         }
     }
@@ -401,10 +1065,32 @@ void System::FindWhichToRemoveToFixJacobian(Group *g, List<hConstraint> *bad, bo
 SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
                           bool andFindBad, bool andFindFree, bool forceDofCheck)
 {
+    double startMs = Milliseconds(), stageMs;
+    stats = {};
     WriteEquationsExceptFor(Constraint::NO_CONSTRAINT, g);
+    stats.writeMs = Milliseconds() - startMs;
+    stats.equations = eq.n;
+    stats.unknowns = param.n;
+
+    // Fill in the rest of our stats on the way out.
+    auto finish = [&](SolveResult how) {
+        stats.initialResidual = sqrt(stats.initialResidual);
+        stats.finalResidual = sqrt(stats.finalResidual);
+        stats.totalMs = Milliseconds() - startMs;
+        return how;
+    };
 
     int i;
-    bool rankOk;
+    bool rankOk, converged;
+
+    // If this is another frame of a drag, then we may already have the
+    // Jacobians. Finding free params takes the whole system, though.
+    uint64_t dragKey = andFindFree ? 0 : DragKey(g, forceDofCheck);
+    if(dragKey != 0 && dragKey == dragCache.key) {
+        if(SolveFromDragCache(dof, &SK.param)) return finish(SolveResult::OKAY);
+    } else if(dragKey != 0 || dragged.n == 0 || dragCache.group.v == g->h.v) {
+        ClearDragCache();
+    }
 
 /*
     dbp("%d equations", eq.n);
@@ -419,9 +1105,15 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
     // All params and equations are assigned to group zero.
     param.ClearTags();
     eq.ClearTags();
+    firstBlock = blocks = 0;
 
     if(!forceDofCheck) {
+        stageMs = Milliseconds();
         SolveBySubstitution();
+        stats.substituteMs = Milliseconds() - stageMs;
+    }
+    for(i = 0; i < param.n; i++) {
+        if(param.elem[i].tag == VAR_SUBSTITUTED) stats.substituted++;
     }
 
     // Before solving the big system, see if we can find any equations that
@@ -429,6 +1121,7 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
     // the system is consistent yet, but if it isn't then we'll catch that
     // later.
     int alone = 1;
+    std::vector<Jacobian> aloneMat;
     for(i = 0; i < eq.n; i++) {
         Equation *e = &(eq.elem[i]);
         if(e->tag != 0) continue;
@@ -442,34 +1135,93 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
 
         e->tag = alone;
         p->tag = alone;
-        WriteJacobian(alone);
-        if(!NewtonSolve(alone)) {
+        stageMs = Milliseconds();
+        WriteJacobian(alone, &mat);
+        stats.writeMs += Milliseconds() - stageMs;
+        if(dragKey != 0) aloneMat.push_back(mat);
+        bool aloneConverged = NewtonSolve(&mat);
+        CountStats(&mat);
+        if(Cancelled()) return finish(SolveResult::CANCELLED);
+        if(!aloneConverged) {
             // We don't do the rank test, so let's arbitrarily return
             // the DIDNT_CONVERGE result here.
-            rankOk = true;
-            // Failed to converge, bail out early
-            goto didnt_converge;
+            SK.constraint.ClearTags();
+            AddUnsatisfiedConstraints(&mat, bad);
+            return finish(SolveResult::DIDNT_CONVERGE);
         }
         alone++;
     }
-
-    // Now write the Jacobian for what's left, and do a rank test; that
-    // tells us if the system is inconsistently constrained.
-    if(!WriteJacobian(0)) {
-        return SolveResult::TOO_MANY_UNKNOWNS;
+    stats.solvedAlone = alone - 1;
+
+    // Now split what's left in to independent blocks, and for each one write
+    // the Jacobian, and do a rank test; that tells us if the system is
+    // inconsistently constrained. Then solve each block as its own system.
+    // If a block doesn't converge, the others are still solved, so that the
+    // rank test and the list of unsatisfied constraints cover all of them,
+    // as if we were solving the leftovers as one big system.
+    FindBlocks(alone);
+    stats.blocks = blocks;
+
+    // Writing the Jacobians allocates temporary memory, so that happens here;
+    // the blocks share no unknowns, so they may then be solved concurrently,
+    // and the results are merged in block order, same as if solved serially.
+    struct BlockResult {
+        bool rankOk;
+        bool converged;
+        bool solvedRankOk;
+    };
+    std::vector<Jacobian> blockMat(blocks);
+    std::vector<BlockResult> blockResult(blocks);
+    size_t entries = 0;
+    stageMs = Milliseconds();
+    for(int b = 0; b < blocks; b++) {
+        WriteJacobian(firstBlock + b, &blockMat[b]);
+        entries += blockMat[b].A.col.size();
+    }
+    stats.writeMs += Milliseconds() - stageMs;
+    auto solveBlock = [&](size_t b) {
+        Jacobian *J = &blockMat[b];
+        BlockResult *r = &blockResult[b];
+        r->rankOk = TestRank(J);
+        r->converged = NewtonSolve(J);
+        r->solvedRankOk = r->converged && TestRank(J);
+    };
+    if(entries >= PARALLEL_MIN_ENTRIES) {
+        ParallelFor(blocks, solveBlock);
+    } else {
+        for(int b = 0; b < blocks; b++) solveBlock(b);
     }
 
-    rankOk = TestRank();
-
-    // And do the leftovers as one big system
-    if(!NewtonSolve(0)) {
-        goto didnt_converge;
+    if(Cancelled()) return finish(SolveResult::CANCELLED);
+
+    rankOk = true;
+    converged = true;
+    bool solvedRankOk = true;
+    for(int b = 0; b < blocks; b++) {
+        const BlockResult &r = blockResult[b];
+        CountStats(&blockMat[b]);
+        if(!r.rankOk) rankOk = false;
+        if(!r.converged) {
+            if(converged) SK.constraint.ClearTags();
+            converged = false;
+            AddUnsatisfiedConstraints(&blockMat[b], bad);
+            continue;
+        }
+        if(!r.solvedRankOk) solvedRankOk = false;
+    }
+    if(!converged) {
+        return finish(rankOk ? SolveResult::DIDNT_CONVERGE :
+                               SolveResult::REDUNDANT_DIDNT_CONVERGE);
     }
 
-    rankOk = TestRank();
+    rankOk = solvedRankOk;
     if(!rankOk) {
         if(!g->allowRedundant) {
-            if(andFindBad) FindWhichToRemoveToFixJacobian(g, bad, forceDofCheck);
+            if(andFindBad) {
+                stageMs = Milliseconds();
+                FindWhichToRemoveToFixJacobian(g, bad, forceDofCheck);
+                stats.findBadMs = Milliseconds() - stageMs;
+            }
         }
     } else {
         // This is not the full Jacobian, but any substitutions or single-eq
@@ -478,9 +1230,31 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
         if(dof) *dof = CalculateDof();
         MarkParamsFree(andFindFree);
     }
+    if(Cancelled()) return finish(SolveResult::CANCELLED);
+
     // System solved correctly, so write the new values back in to the
     // main parameter table.
-    for(i = 0; i < param.n; i++) {
+    WriteParamsBack(&SK.param);
+
+    if(dragKey != 0 && rankOk) {
+        // Keep this solve for the next frame of the drag. The Jacobians point
+        // in to our param table, so the cache takes that, and we keep a copy.
+        ClearDragCache();
+        dragCache.key = dragKey;
+        dragCache.group = g->h;
+        std::swap(dragCache.param, param);
+        for(i = 0; i < dragCache.param.n; i++) {
+            param.Add(&(dragCache.param.elem[i]));
+        }
+        dragCache.alone = std::move(aloneMat);
+        dragCache.block = std::move(blockMat);
+        dragCache.dof = dof ? *dof : 0;
+    }
+    return finish(rankOk ? SolveResult::OKAY : SolveResult::REDUNDANT_OKAY);
+}
+
+void System::WriteParamsBack(ParamList *dest) {
+    for(int i = 0; i < param.n; i++) {
         Param *p = &(param.elem[i]);
         double val;
         if(p->tag == VAR_SUBSTITUTED) {
@@ -488,33 +1262,199 @@ SolveResult System::Solve(Group *g, int *dof, List<hConstraint> *bad,
         } else {
             val = p->val;
         }
-        Param *pp = SK.GetParam(p->h);
+        Param *pp = dest->FindById(p->h);
         pp->val = val;
         pp->known = true;
         pp->free = p->free;
     }
-    return rankOk ? SolveResult::OKAY : SolveResult::REDUNDANT_OKAY;
+}
 
-didnt_converge:
-    SK.constraint.ClearTags();
-    for(i = 0; i < eq.n; i++) {
-        if(ffabs(mat.B.num[i]) > CONVERGE_TOLERANCE || isnan(mat.B.num[i])) {
-            // This constraint is unsatisfied.
-            if(!mat.eq[i].isFromConstraint()) continue;
+//-----------------------------------------------------------------------------
+// A hash of everything that goes in to the compiled Jacobians, except for the
+// values of our unknowns: the equations, the params that are known (and so
+// become constants), and whatever decides the substitutions and the blocks.
+// Zero if this system isn't worth caching, or can't be.
+//-----------------------------------------------------------------------------
+static uint64_t HashMix(uint64_t h, uint64_t v) {
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
 
-            hConstraint hc = mat.eq[i].constraint();
-            ConstraintBase *c = SK.constraint.FindByIdNoOops(hc);
-            if(!c) continue;
-            // Don't double-show constraints that generated multiple
-            // unsatisfied equations
-            if(!c->tag) {
-                bad->Add(&(c->h));
-                c->tag = 1;
+static uint64_t HashDouble(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+static bool HashExpr(const Expr *e, ParamList *param, bool allowPointers,
+                     std::unordered_map<const Expr *, uint64_t> *memo, uint64_t *h)
+{
+    auto it = memo->find(e);
+    if(it != memo->end()) {
+        *h = it->second;
+        return true;
+    }
+
+    uint64_t r = HashMix(0, (uint64_t)e->op);
+    switch(e->op) {
+        case Expr::Op::PARAM: {
+            // Same as DeepCopyWithParamsAsPointers, known params become
+            // constants and the rest become pointers. A param from the
+            // sketch that isn't known would be read through its pointer;
+            // that's only allowed if the caller keeps it in place for as
+            // long as the cache is used.
+            Param *p = param->FindByIdNoOops(e->parh);
+            if(!p) {
+                p = SK.param.FindByIdNoOops(e->parh);
+                if(!p || (!p->known && !allowPointers)) return false;
             }
+            r = HashMix(r, p->known ? HashDouble(p->val) : e->parh.v);
+            break;
+        }
+
+        case Expr::Op::CONSTANT:
+            r = HashMix(r, HashDouble(e->v));
+            break;
+
+        case Expr::Op::PARAM_PTR:
+        case Expr::Op::VARIABLE:
+            return false;
+
+        default: {
+            uint64_t ha, hb = 0;
+            if(!HashExpr(e->a, param, allowPointers, memo, &ha)) return false;
+            if(e->Children() > 1 &&
+               !HashExpr(e->b, param, allowPointers, memo, &hb)) return false;
+            r = HashMix(HashMix(r, ha), hb);
+            break;
+        }
+    }
+    (*memo)[e] = r;
+    *h = r;
+    return true;
+}
+
+uint64_t System::DragKey(Group *g, bool forceDofCheck) {
+    bool draggedHere = false;
+    for(hParam &hp : dragged) {
+        if(param.FindByIdNoOops(hp)) draggedHere = true;
+    }
+    if(!draggedHere && !keepJacobians) return 0;
+
+    uint64_t h = HashMix(g->h.v, forceDofCheck ? 1 : 2);
+    for(Param &p : param) {
+        h = HashMix(h, p.h.v);
+    }
+    for(hParam &hp : dragged) {
+        h = HashMix(h, hp.v);
+    }
+    std::unordered_map<const Expr *, uint64_t> memo;
+    for(Equation &e : eq) {
+        uint64_t he;
+        if(!HashExpr(e.e, &param, keepJacobians, &memo, &he)) return 0;
+        h = HashMix(HashMix(h, e.h.v), he);
+    }
+    return (h == 0) ? 1 : h;
+}
+
+void System::ClearDragCache() {
+    dragCache.key = 0;
+    dragCache.param.Clear();
+    dragCache.alone.clear();
+    dragCache.block.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Take a copy of another system's drag cache, and of what it was dragging, so
+// that it may be solved again from other values at the same time as the
+// original. The copied Jacobians are pointed at our copy of the param table.
+//-----------------------------------------------------------------------------
+void System::CopyDragCacheFrom(const System &from) {
+    ClearDragCache();
+    dragCache.key   = from.dragCache.key;
+    dragCache.group = from.dragCache.group;
+    dragCache.dof   = from.dragCache.dof;
+    for(int i = 0; i < from.dragCache.param.n; i++) {
+        Param p = from.dragCache.param.elem[i];
+        dragCache.param.Add(&p);
+    }
+    dragCache.alone = from.dragCache.alone;
+    dragCache.block = from.dragCache.block;
+    for(std::vector<Jacobian> *mats : { &dragCache.alone, &dragCache.block }) {
+        for(Jacobian &J : *mats) {
+            J.values.Rebase(from.dragCache.param.elem, dragCache.param.elem,
+                            dragCache.param.n);
+        }
+    }
+
+    dragged.Clear();
+    for(int i = 0; i < from.dragged.n; i++) {
+        hParam hp = from.dragged.elem[i];
+        dragged.Add(&hp);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Solve the system that's in our drag cache, starting from the values in our
+// param table. That's only the numerical part of a solve; if anything goes
+// wrong, then we return false, and the caller solves from scratch.
+//-----------------------------------------------------------------------------
+bool System::SolveFromDragCache(int *dof, ParamList *dest) {
+    ssassert(dragCache.param.n == param.n, "Expected the same params");
+    for(int i = 0; i < param.n; i++) {
+        dragCache.param.elem[i].val = param.elem[i].val;
+    }
+    // So the Jacobians now point in to our param table.
+    std::swap(dragCache.param, param);
+
+    bool ok = true;
+    for(Jacobian &J : dragCache.alone) {
+        bool converged = NewtonSolve(&J);
+        CountStats(&J);
+        if(!converged) {
+            ok = false;
+            break;
+        }
+    }
+    if(ok) {
+        size_t blocks = dragCache.block.size();
+        std::vector<char> blockOk(blocks);
+        size_t entries = 0;
+        for(Jacobian &J : dragCache.block) {
+            J.rankTests = 0;
+            J.rankMs = 0;
+            entries += J.A.col.size();
+        }
+        auto solveBlock = [&](size_t b) {
+            Jacobian *J = &dragCache.block[b];
+            blockOk[b] = NewtonSolve(J) && TestRank(J);
+        };
+        if(entries >= PARALLEL_MIN_ENTRIES) {
+            ParallelFor(blocks, solveBlock);
+        } else {
+            for(size_t b = 0; b < blocks; b++) solveBlock(b);
+        }
+        for(size_t b = 0; b < blocks; b++) {
+            CountStats(&dragCache.block[b]);
+            if(!blockOk[b]) ok = false;
+        }
+    }
+    if(ok) {
+        MarkParamsFree(/*findFree=*/false);
+        WriteParamsBack(dest);
+        if(dof) *dof = dragCache.dof;
+
+        stats.fromDragCache = true;
+        stats.solvedAlone = (int)dragCache.alone.size();
+        stats.blocks = (int)dragCache.block.size();
+        for(int i = 0; i < param.n; i++) {
+            if(param.elem[i].tag == VAR_SUBSTITUTED) stats.substituted++;
         }
     }
 
-    return rankOk ? SolveResult::DIDNT_CONVERGE : SolveResult::REDUNDANT_DIDNT_CONVERGE;
+    std::swap(dragCache.param, param);
+    if(!ok) ClearDragCache();
+    return ok;
 }
 
 SolveResult System::SolveRank(Group *g, int *dof, List<hConstraint> *bad,
@@ -530,13 +1470,17 @@ SolveResult System::SolveRank(Group *g, int *dof, List<hConstraint> *bad,
         SolveBySubstitution();
     }
 
-    // Now write the Jacobian, and do a rank test; that
-    // tells us if the system is inconsistently constrained.
-    if(!WriteJacobian(0)) {
-        return SolveResult::TOO_MANY_UNKNOWNS;
+    // Now write the Jacobian for each independent block, and do a rank
+    // test; that tells us if the system is inconsistently constrained.
+    FindBlocks(1);
+    bool rankOk = true;
+    for(int b = firstBlock; b < firstBlock + blocks; b++) {
+        WriteJacobian(b, &mat);
+        if(!TestRank(&mat)) {
+            rankOk = false;
+            break;
+        }
     }
-
-    bool rankOk = TestRank();
     if(!rankOk) {
         if(!g->allowRedundant) {
             if(andFindBad) FindWhichToRemoveToFixJacobian(g, bad, forceDofCheck);
@@ -556,32 +1500,47 @@ void System::Clear() {
     param.Clear();
     eq.Clear();
     dragged.Clear();
+    ClearDragCache();
 }
 
 void System::MarkParamsFree(bool find) {
     // If requested, find all the free (unbound) variables. This might be
     // more than the number of degrees of freedom. Don't always do this,
-    // because the display would get annoying and it's slow.
+    // because the display would get annoying and it's slow. The system is
+    // known to be full rank here, so it's enough to test the block that the
+    // variable is in, and a variable that's in no block is free.
     for(int i = 0; i < param.n; i++) {
         Param *p = &(param.elem[i]);
         p->free = false;
 
         if(find) {
             if(p->tag == 0) {
+                p->free = true;
+            } else if(IsBlockTag(p->tag)) {
+                int b = p->tag;
                 p->tag = VAR_DOF_TEST;
-                WriteJacobian(0);
-                EvalJacobian();
-                int rank = CalculateRank();
+                WriteJacobian(b, &mat);
+                EvalJacobian(&mat);
+                int rank = CalculateRank(&mat);
                 if(rank == mat.m) {
                     p->free = true;
                 }
-                p->tag = 0;
+                p->tag = b;
             }
         }
     }
 }
 
 int System::CalculateDof() {
-    return mat.n - mat.m;
+    // The unknowns that are left, less the (independent) equations that
+    // constrain them.
+    int dof = 0;
+    for(int i = 0; i < param.n; i++) {
+        int tag = param.elem[i].tag;
+        if(tag == 0 || IsBlockTag(tag)) dof++;
+    }
+    for(int i = 0; i < eq.n; i++) {
+        if(IsBlockTag(eq.elem[i].tag)) dof--;
+    }
+    return dof;
 }
-
@@ -460,6 +460,27 @@ list_items:
         }
     }
     if(a == 0) Printf(false, "%Ba   (none)");
+
+    // The references aren't solved.
+    if(shown.group.v == Group::HGROUP_REFERENCES.v) return;
+
+    const SolveStats &st = g->solved.stats;
+    Printf(false, "");
+    Printf(false, "%Ft solver%E %s",
+        st.fromDragCache ? "(reused Jacobians from drag)" : "");
+    Printf(false, "%Ba   %d equations, %d unknowns, %d substituted",
+        st.equations, st.unknowns, st.substituted);
+    Printf(false, "%Bd   %d solved alone, %d blocks",
+        st.solvedAlone, st.blocks);
+    Printf(false, "%Ba   %d Newton iterations, %d rank tests",
+        st.iterations, st.rankTests);
+    Printf(false, "%Bd   residual %s before, %s after",
+        ssprintf("%.2e", st.initialResidual).c_str(),
+        ssprintf("%.2e", st.finalResidual).c_str());
+    Printf(false, "%Ba   %@ ms: write %@, substitute %@,",
+        st.totalMs, st.writeMs, st.substituteMs);
+    Printf(false, "%Bd      newton %@, rank %@, find bad %@",
+        st.newtonMs, st.rankMs, st.findBadMs);
 }
 
 //-----------------------------------------------------------------------------
@@ -507,6 +528,11 @@ void TextWindow::ShowGroupSolveInfo() {
             Printf(true, "Too many unknowns in a single group!");
             return;
 
+        case SolveResult::CANCELLED:
+            Printf(true, "Solving was stopped before it finished;");
+            Printf(false, "it's solved again on the next change.");
+            return;
+
         default: ssassert(false, "Unexpected solve result");
     }
 
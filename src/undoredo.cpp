@@ -63,6 +63,8 @@ void SolveSpaceUI::PushFromCurrentOnto(UndoStack *uk) {
         dest.runningMesh = {};
         dest.thisShell = {};
         dest.runningShell = {};
+        dest.thisKey = 0;
+        dest.runningKey = 0;
         dest.displayMesh = {};
         dest.displayOutlines = {};
 
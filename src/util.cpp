@@ -4,6 +4,10 @@
 //
 // Copyright 2008-2013 Jonathan Westhues.
 //-----------------------------------------------------------------------------
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "solvespace.h"
 
 using namespace SolveSpace;
@@ -58,6 +62,107 @@ int64_t SolveSpace::GetMilliseconds()
     return std::chrono::duration_cast<std::chrono::milliseconds>(timestamp).count();
 }
 
+//-----------------------------------------------------------------------------
+// A pool of worker threads, for running independent pieces of work (e.g. the
+// blocks of an equation system) concurrently. The pool is created the first
+// time it's needed, and then lives for as long as the process does; it's
+// deliberately never destroyed, since joining threads from static destructors
+// is not safe everywhere that we might be loaded as a library.
+//-----------------------------------------------------------------------------
+namespace {
+class WorkerPool {
+public:
+    std::vector<std::thread>            threads;
+    // Held by whoever is using the pool; there's only one job at a time.
+    std::mutex                          busy;
+
+    std::mutex                          mutex;
+    std::condition_variable             wake;
+    std::condition_variable             idle;
+    const std::function<void(size_t)>  *job;
+    size_t                              jobSize;
+    std::atomic<size_t>                 next;
+    unsigned                            generation;
+    unsigned                            running;
+
+    static thread_local bool            isWorker;
+
+    WorkerPool() : job(NULL), jobSize(0), next(0), generation(0), running(0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        // The thread that posts a job works on it too.
+        for(unsigned i = 1; i < cores; i++) {
+            threads.emplace_back([this] { Worker(); });
+        }
+    }
+
+    void RunJob() {
+        for(;;) {
+            size_t i = next.fetch_add(1);
+            if(i >= jobSize) break;
+            (*job)(i);
+        }
+    }
+
+    void Worker() {
+        isWorker = true;
+        unsigned seen = 0;
+        for(;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return generation != seen; });
+                seen = generation;
+                running++;
+            }
+            RunJob();
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                running--;
+                if(running == 0) idle.notify_all();
+            }
+        }
+    }
+
+    void Run(size_t n, const std::function<void(size_t)> &fn) {
+        {
+            // A worker might still be finding out that the last job is done.
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [&] { return running == 0; });
+            job     = &fn;
+            jobSize = n;
+            next    = 0;
+            generation++;
+        }
+        wake.notify_all();
+        RunJob();
+        // Every index has been claimed, but wait until the workers are done
+        // with theirs; this also ensures that no worker still refers to this
+        // job once we return.
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [&] { return running == 0; });
+        job = NULL;
+    }
+};
+
+thread_local bool WorkerPool::isWorker = false;
+}
+
+void SolveSpace::ParallelFor(size_t n, const std::function<void(size_t)> &fn) {
+    static WorkerPool *pool = new WorkerPool();
+
+    // Nested calls, calls made while the pool is busy with another job, and
+    // calls with nothing to split just run on this thread.
+    if(n < 2 || pool->threads.empty() || WorkerPool::isWorker) {
+        for(size_t i = 0; i < n; i++) fn(i);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(pool->busy, std::try_to_lock);
+    if(!lock.owns_lock()) {
+        for(size_t i = 0; i < n; i++) fn(i);
+        return;
+    }
+    pool->Run(n, fn);
+}
+
 void SolveSpace::MakeMatrix(double *mat,
                             double a11, double a12, double a13, double a14,
                             double a21, double a22, double a23, double a24,
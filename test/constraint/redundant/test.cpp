@@ -0,0 +1,20 @@
+#include "harness.h"
+
+TEST_CASE(square_removable) {
+    // A square with horizontal and vertical sides, and the lengths of both
+    // horizontal sides dimensioned; so one of those is redundant, though
+    // consistent.
+    CHECK_LOAD("square.slvs");
+    Group *g = SK.GetGroup(SK.constraint.elem[0].group);
+    CHECK_TRUE(g->solved.how == SolveResult::REDUNDANT_OKAY);
+
+    // The redundancy is in x, so removing any constraint that fixes x would
+    // fix it; but not the horizontal constraints, which only fix y.
+    for(Constraint &c : SK.constraint) {
+        bool removable = false;
+        for(hConstraint &hc : g->solved.remove) {
+            if(hc.v == c.h.v) removable = true;
+        }
+        CHECK_TRUE(removable == (c.type != Constraint::Type::HORIZONTAL));
+    }
+}
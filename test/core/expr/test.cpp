@@ -110,3 +110,103 @@ TEST_CASE(errors) {
   CHECK_PARSE_ERR("(",
                   "Expected ')'");
 }
+
+TEST_CASE(tape) {
+  Param p = {};
+  p.val = 0.25;
+  Expr *x = Expr::AllocExpr();
+  x->op = Expr::Op::PARAM_PTR;
+  x->parp = &p;
+
+  Expr *e[3];
+  e[0] = x->Times(Expr::From(3.0))->Plus(Expr::From(1.0));
+  e[1] = x->Sin()->Square()->Plus(x->Cos()->Square())->Sqrt();
+  e[2] = x->ACos()->Div(x->ASin()->Negate())->Minus(x);
+
+  ExprTape tape = {};
+  ExprParams params = {};
+  for(int i = 0; i < 3; i++) {
+    CHECK_TRUE(tape.Add(e[i], &params) == (size_t)i);
+  }
+  CHECK_TRUE(params.param.size() == 1);
+  double r[3];
+  for(double v : { 0.25, -0.5, 0.75 }) {
+    p.val = v;
+    params.Gather();
+    tape.Eval(params.val.data(), r);
+    for(int i = 0; i < 3; i++) {
+      CHECK_TRUE(r[i] == e[i]->Eval());
+    }
+  }
+}
+
+TEST_CASE(tape_adjoint) {
+  Param p = {}, q = {};
+  p.h.v = 1;
+  q.h.v = 2;
+  Expr *x = Expr::AllocExpr();
+  x->op = Expr::Op::PARAM_PTR;
+  x->parp = &p;
+  Expr *y = Expr::AllocExpr();
+  y->op = Expr::Op::PARAM_PTR;
+  y->parp = &q;
+
+  Expr *e = x->Times(y)->Div(x->Sin()->Plus(Expr::From(2.0)))
+             ->Minus(y->Square()->Sqrt())->Plus(x->Times(Expr::From(0.5))->ACos());
+  Expr *dx = e->PartialWrt(p.h), *dy = e->PartialWrt(q.h);
+
+  ExprTape tape = {};
+  ExprParams params = {};
+  tape.Add(Expr::From(1.0), &params);
+  size_t i = tape.Add(e, &params);
+  std::vector<double> r(2);
+  for(double v : { 0.25, -0.5, 1.5 }) {
+    p.val = v;
+    q.val = 2*v + 3;
+    params.Gather();
+    tape.Eval(params.val.data(), r.data());
+    tape.Adjoint(i);
+    double gx = 0, gy = 0;
+    for(size_t c = tape.codeStart[i]; c < tape.code.size(); c++) {
+      const ExprTape::Instr &in = tape.code[c];
+      if(in.op != Expr::Op::PARAM_PTR) continue;
+      if(params.param[in.a] == &p) gx += tape.adj[in.r];
+      if(params.param[in.a] == &q) gy += tape.adj[in.r];
+    }
+    CHECK_EQ_EPS(gx, dx->Eval());
+    CHECK_EQ_EPS(gy, dy->Eval());
+  }
+}
+
+TEST_CASE(interned) {
+  hParam hx = { 1 }, hy = { 2 }, hz = { 3 };
+  Expr *x = Expr::From(hx), *y = Expr::From(hy);
+  CHECK_TRUE(Expr::From(hx) == x);
+  CHECK_TRUE(Expr::From(1.25) == Expr::From(1.25));
+  CHECK_TRUE(x->Plus(y)->Sqrt() == Expr::From(hx)->Plus(Expr::From(hy))->Sqrt());
+  CHECK_TRUE(x->Plus(y) != y->Plus(x));
+
+  // Substituting in one expression leaves the others that share its nodes
+  Expr *e = x->Plus(y)->Times(x), *f = x->Plus(y);
+  Expr *g = e->Substitute(hx, hz);
+  CHECK_TRUE(g == Expr::From(hz)->Plus(y)->Times(Expr::From(hz)));
+  CHECK_TRUE(e == f->Times(x));
+  CHECK_TRUE(f->a == x);
+}
+
+TEST_CASE(tape_shared) {
+  Param p = {};
+  p.val = 0.5;
+  Expr *x = Expr::From(&p);
+  Expr *s = x->Sin()->Plus(Expr::From(2.0));
+  Expr *e = s->Times(s)->Minus(s->Sqrt());
+
+  ExprTape tape = {};
+  ExprParams params = {};
+  tape.Add(e, &params);
+  // x, sin, plus, times, sqrt, minus; the constant isn't on the tape
+  CHECK_TRUE(tape.code.size() == 6);
+  double r;
+  tape.Eval(params.val.data(), &r);
+  CHECK_TRUE(r == e->Eval());
+}
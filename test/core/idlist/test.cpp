@@ -0,0 +1,94 @@
+#include "harness.h"
+
+static Param MakeParam(uint32_t v, double val) {
+    Param p = {};
+    p.h.v = v;
+    p.val = val;
+    return p;
+}
+
+TEST_CASE(add_out_of_order) {
+    ParamList l = {};
+    for(uint32_t v : { 5u, 1u, 9u, 3u, 7u }) {
+        Param p = MakeParam(v, v * 10.0);
+        l.Add(&p);
+    }
+    CHECK_TRUE(l.n == 5);
+    for(int i = 1; i < l.n; i++) {
+        CHECK_TRUE(l.elem[i - 1].h.v < l.elem[i].h.v);
+    }
+    for(uint32_t v : { 1u, 3u, 5u, 7u, 9u }) {
+        hParam h = { v };
+        CHECK_TRUE(l.FindById(h)->val == v * 10.0);
+    }
+    hParam missing = { 4 };
+    CHECK_TRUE(l.FindByIdNoOops(missing) == NULL);
+    l.Clear();
+}
+
+TEST_CASE(indexed_matches_sorted) {
+    IdList<Param,hParam> sorted = {};
+    ParamList indexed = {};
+    for(uint32_t i = 0; i < 2000; i++) {
+        uint32_t v = 1 + (i * 7919) % 4001;
+        hParam h = { v };
+        if(sorted.FindByIdNoOops(h)) continue;
+        Param p = MakeParam(v, i);
+        sorted.Add(&p);
+        indexed.Add(&p);
+        if(i % 5 == 0) {
+            hParam hr = { 1 + (i * 31) % 4001 };
+            if(sorted.FindByIdNoOops(hr)) {
+                sorted.RemoveById(hr);
+                indexed.RemoveById(hr);
+            }
+        }
+    }
+    CHECK_TRUE(sorted.n == indexed.n);
+    for(int i = 0; i < sorted.n; i++) {
+        CHECK_TRUE(sorted.elem[i].h.v == indexed.elem[i].h.v);
+    }
+    for(uint32_t v = 1; v <= 4001; v++) {
+        hParam h = { v };
+        Param *a = sorted.FindByIdNoOops(h), *b = indexed.FindByIdNoOops(h);
+        CHECK_TRUE((a == NULL) == (b == NULL));
+        if(a && b) CHECK_TRUE(a->val == b->val);
+    }
+    sorted.Clear();
+    indexed.Clear();
+}
+
+TEST_CASE(add_unsorted) {
+    ParamList l = {};
+    for(uint32_t v = 100; v > 0; v--) {
+        Param p = MakeParam(v, v);
+        l.AddUnsorted(&p);
+    }
+    l.SortById();
+    for(int i = 0; i < l.n; i++) {
+        CHECK_TRUE(l.elem[i].h.v == (uint32_t)i + 1);
+    }
+    hParam h = { 42 };
+    CHECK_TRUE(l.FindById(h)->val == 42);
+    l.Clear();
+}
+
+TEST_CASE(remove_by_ids) {
+    ParamList l = {};
+    for(uint32_t v = 1; v <= 10; v++) {
+        Param p = MakeParam(v, v);
+        l.Add(&p);
+    }
+    std::vector<hParam> hs = { { 2 }, { 9 }, { 5 }, { 2 } };
+    l.RemoveByIds(hs);
+    CHECK_TRUE(l.n == 7);
+    for(uint32_t v = 1; v <= 10; v++) {
+        hParam h = { v };
+        bool removed = (v == 2 || v == 5 || v == 9);
+        CHECK_TRUE((l.FindByIdNoOops(h) == NULL) == removed);
+    }
+    for(int i = 1; i < l.n; i++) {
+        CHECK_TRUE(l.elem[i - 1].h.v < l.elem[i].h.v);
+    }
+    l.Clear();
+}
@@ -0,0 +1,166 @@
+#include "harness.h"
+
+namespace SolveSpace {
+    // These are defined in headless.cpp, and aren't exposed in solvespace.h.
+    extern int escapePolls;
+    extern int escapeDownAtPoll;
+}
+
+// In normal.slvs, a sketch with a dimensioned width is extruded, with the
+// depth of the extrusion set by a diagonal from that width; and a second
+// sketch, in another workplane, is extruded too.
+static const hGroup      FIRST_SKETCH   = { 3 };
+static const hGroup      FIRST_EXTRUDE  = { 4 };
+static const hGroup      SECOND_SKETCH  = { 5 };
+static const hGroup      SECOND_EXTRUDE = { 6 };
+static const hConstraint WIDTH          = { 9 };
+// The corner of the first extrusion, at its depth above the origin.
+static const hEntity     TOP_CORNER     = { 0x8004002a };
+
+static void ChangeWidth(double width) {
+    SK.GetConstraint(WIDTH)->valA = width;
+    SS.MarkGroupDirty(FIRST_SKETCH);
+}
+
+static std::vector<Vector> PointsIn(hGroup hg) {
+    std::vector<Vector> points;
+    for(Entity &e : SK.entity) {
+        if(e.group.v == hg.v && e.IsPoint()) points.push_back(e.PointGetNum());
+    }
+    return points;
+}
+
+static std::vector<STriangle> DisplayMeshOf(hGroup hg) {
+    Group *g = SK.GetGroup(hg);
+    g->GenerateDisplayItems();
+    std::vector<STriangle> mesh;
+    for(STriangle &tr : g->displayMesh.l) mesh.push_back(tr);
+    return mesh;
+}
+
+static void CheckSameMesh(Test::Helper *helper, const std::vector<STriangle> &mesh) {
+    std::vector<STriangle> after = DisplayMeshOf(SECOND_EXTRUDE);
+    CHECK_TRUE(after.size() == mesh.size());
+    for(size_t i = 0; i < mesh.size() && i < after.size(); i++) {
+        CHECK_TRUE(after[i].a.Equals(mesh[i].a));
+        CHECK_TRUE(after[i].b.Equals(mesh[i].b));
+        CHECK_TRUE(after[i].c.Equals(mesh[i].c));
+    }
+}
+
+// Regenerating only what's dirty should leave the sketch and the solid model
+// just as regenerating everything would.
+static void CheckSameAsGenerateAll(Test::Helper *helper) {
+    std::vector<Param> params;
+    for(Param &p : SK.param) params.push_back(p);
+    std::vector<STriangle> mesh = DisplayMeshOf(SECOND_EXTRUDE);
+
+    SS.GenerateAll(SolveSpaceUI::Generate::ALL);
+    CHECK_TRUE(SK.param.n == (int)params.size());
+    for(size_t i = 0; i < params.size(); i++) {
+        Param *p = SK.GetParam(params[i].h);
+        CHECK_EQ_EPS(p->val, params[i].val);
+    }
+    for(Group &gi : SK.group) {
+        CHECK_TRUE(gi.IsSolvedOkay());
+    }
+
+    CheckSameMesh(helper, mesh);
+}
+
+TEST_CASE(independent_group) {
+    CHECK_LOAD("normal.slvs");
+    std::vector<Vector> before = PointsIn(SECOND_SKETCH);
+    CHECK_TRUE(!before.empty());
+
+    ChangeWidth(12);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    std::vector<Vector> after = PointsIn(SECOND_SKETCH);
+    CHECK_TRUE(after.size() == before.size());
+    for(size_t i = 0; i < before.size(); i++) {
+        CHECK_TRUE(after[i].Equals(before[i]));
+    }
+    CheckSameAsGenerateAll(helper);
+}
+
+TEST_CASE(dependent_group) {
+    CHECK_LOAD("normal.slvs");
+    CHECK_EQ_EPS(SK.GetEntity(TOP_CORNER)->PointGetNum().z, 12);
+
+    ChangeWidth(12);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    CHECK_EQ_EPS(SK.GetEntity(TOP_CORNER)->PointGetNum().z, 5);
+    CheckSameAsGenerateAll(helper);
+}
+
+TEST_CASE(group_after_active) {
+    CHECK_LOAD("normal.slvs");
+    SS.GW.activeGroup = FIRST_EXTRUDE;
+
+    ChangeWidth(12);
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    CHECK_EQ_EPS(SK.GetEntity(TOP_CORNER)->PointGetNum().z, 5);
+    // The solid model after the active group is built on the one that just
+    // changed, so that has to be made again once it's shown.
+    CHECK_FALSE(SK.GetGroup(SECOND_EXTRUDE)->clean);
+
+    SS.GW.activeGroup = SECOND_EXTRUDE;
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    CHECK_TRUE(SK.GetGroup(SECOND_EXTRUDE)->clean);
+    CheckSameAsGenerateAll(helper);
+}
+
+TEST_CASE(cancelled) {
+    CHECK_LOAD("normal.slvs");
+
+    ChangeWidth(12);
+    SS.CancelGenerate();
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    // Nothing was solved, and what was changed is left to do.
+    CHECK_EQ_EPS(SK.GetEntity(TOP_CORNER)->PointGetNum().z, 12);
+    CHECK_FALSE(SK.GetGroup(FIRST_SKETCH)->clean);
+    CHECK_FALSE(SS.generateCancelled);
+
+    SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+    CHECK_EQ_EPS(SK.GetEntity(TOP_CORNER)->PointGetNum().z, 5);
+    CheckSameAsGenerateAll(helper);
+}
+
+TEST_CASE(escape_stopped) {
+    // Stop a regeneration at each time that it looks at the Esc key in turn,
+    // from the solver through the Booleans, until one finishes first. The
+    // width is different each time, so that nothing comes from the cache.
+    int stops = 0;
+    for(int n = 1; n < 1000; n++) {
+        CHECK_LOAD("normal.slvs");
+        std::vector<STriangle> mesh = DisplayMeshOf(SECOND_EXTRUDE);
+        std::vector<int> surfaces;
+        for(Group &g : SK.group) surfaces.push_back(g.runningShell.surface.n);
+
+        double width = 12 - n*0.01;
+        ChangeWidth(width);
+        escapePolls = 0;
+        escapeDownAtPoll = n;
+        SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+        escapeDownAtPoll = 0;
+        bool pressed = (escapePolls >= n);
+        CHECK_FALSE(SS.generateCancelled);
+        CHECK_TRUE(SS.EscapeStoppedGenerate() == pressed);
+        SS.escapeStoppedGenerateAt = 0;
+
+        if(!SK.GetGroup(FIRST_SKETCH)->clean) {
+            // It was stopped, so every group still has its old solid model.
+            stops++;
+            for(int i = 0; i < SK.group.n; i++) {
+                CHECK_TRUE(SK.group.elem[i].runningShell.surface.n == surfaces[i]);
+            }
+            CheckSameMesh(helper, mesh);
+            SS.GenerateAll(SolveSpaceUI::Generate::DIRTY);
+        }
+        // The depth is set by a diagonal of 13 from the width.
+        CHECK_EQ_EPS(SK.GetEntity(TOP_CORNER)->PointGetNum().z, sqrt(169 - width*width));
+        CheckSameAsGenerateAll(helper);
+        if(!pressed) break;
+    }
+    CHECK_TRUE(stops > 0);
+}
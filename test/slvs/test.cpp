@@ -0,0 +1,260 @@
+//-----------------------------------------------------------------------------
+// Tests for the solver library, against its public interface. These can't
+// use the harness, since the library has its own copy of the sketch.
+//-----------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <slvs.h>
+
+static int checks = 0, failures = 0;
+
+#define CHECK_TRUE(cond) \
+    do { \
+        checks++; \
+        if(!(cond)) { \
+            failures++; \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while(0)
+
+static const double LENGTH_EPS = 1e-6;
+
+static Slvs_Param    param[50];
+static Slvs_Entity   entity[50];
+static Slvs_Constraint constraint[50];
+
+// A workplane and an anchor point in group 1, which are constant when solving
+// group 2; and in group 2, a triangle ABC with A on the anchor, AB horizontal,
+// and the lengths of all three sides dimensioned. The length of AC is
+// constraint 4.
+static Slvs_System MakeTriangle() {
+    Slvs_System sys = {};
+    sys.param      = param;
+    sys.entity     = entity;
+    sys.constraint = constraint;
+    sys.failed     = NULL;
+    sys.calculateFaileds = 0;
+
+    Slvs_hGroup g = 1;
+    double qw, qx, qy, qz;
+    sys.param[sys.params++] = Slvs_MakeParam(1, g, 0.0);
+    sys.param[sys.params++] = Slvs_MakeParam(2, g, 0.0);
+    sys.param[sys.params++] = Slvs_MakeParam(3, g, 0.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint3d(101, g, 1, 2, 3);
+    Slvs_MakeQuaternion(1, 0, 0,
+                        0, 1, 0, &qw, &qx, &qy, &qz);
+    sys.param[sys.params++] = Slvs_MakeParam(4, g, qw);
+    sys.param[sys.params++] = Slvs_MakeParam(5, g, qx);
+    sys.param[sys.params++] = Slvs_MakeParam(6, g, qy);
+    sys.param[sys.params++] = Slvs_MakeParam(7, g, qz);
+    sys.entity[sys.entities++] = Slvs_MakeNormal3d(102, g, 4, 5, 6, 7);
+    sys.entity[sys.entities++] = Slvs_MakeWorkplane(200, g, 101, 102);
+
+    sys.param[sys.params++] = Slvs_MakeParam(10, g, 0.0);
+    sys.param[sys.params++] = Slvs_MakeParam(11, g, 0.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint2d(301, g, 200, 10, 11);
+
+    g = 2;
+    sys.param[sys.params++] = Slvs_MakeParam(20, g, 1.0);
+    sys.param[sys.params++] = Slvs_MakeParam(21, g, 1.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint2d(401, g, 200, 20, 21);
+    sys.param[sys.params++] = Slvs_MakeParam(22, g, 9.0);
+    sys.param[sys.params++] = Slvs_MakeParam(23, g, 2.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint2d(402, g, 200, 22, 23);
+    sys.param[sys.params++] = Slvs_MakeParam(24, g, 15.0);
+    sys.param[sys.params++] = Slvs_MakeParam(25, g, 10.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint2d(403, g, 200, 24, 25);
+    sys.entity[sys.entities++] = Slvs_MakeLineSegment(410, g, 200, 401, 402);
+
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+            1, g, SLVS_C_POINTS_COINCIDENT, 200, 0.0, 401, 301, 0, 0);
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+            2, g, SLVS_C_HORIZONTAL, 200, 0.0, 0, 0, 410, 0);
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+            3, g, SLVS_C_PT_PT_DISTANCE, 200, 10.0, 401, 402, 0, 0);
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+            4, g, SLVS_C_PT_PT_DISTANCE, 200, 20.0, 401, 403, 0, 0);
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+            5, g, SLVS_C_PT_PT_DISTANCE, 200, 15.0, 402, 403, 0, 0);
+    return sys;
+}
+
+static int ParamIndex(const Slvs_System &sys, Slvs_hParam h) {
+    for(int i = 0; i < sys.params; i++) {
+        if(sys.param[i].h == h) return i;
+    }
+    return -1;
+}
+
+static void TestBatch() {
+    Slvs_System sys = MakeTriangle();
+    int n = sys.params;
+
+    // Set 0 is the initial guess; set 1 moves the anchor, which is constant
+    // in group 2; set 2 flips C below AB; and set 3 starts with C on the line
+    // through A and B, which it can't leave, so it fails to solve.
+    const int count = 4;
+    std::vector<double> vals;
+    for(int k = 0; k < count; k++) {
+        for(int i = 0; i < n; i++) vals.push_back(sys.param[i].val);
+    }
+    vals[1*n + ParamIndex(sys, 10)] = 5.0;
+    vals[1*n + ParamIndex(sys, 11)] = 3.0;
+    vals[2*n + ParamIndex(sys, 25)] = -10.0;
+    vals[3*n + ParamIndex(sys, 21)] = 0.0;
+    vals[3*n + ParamIndex(sys, 23)] = 0.0;
+    vals[3*n + ParamIndex(sys, 25)] = 0.0;
+
+    // The reference, from solving each set by itself.
+    std::vector<double> refVals = vals;
+    std::vector<int> refResult(count), refDof(count);
+    for(int k = 0; k < count; k++) {
+        for(int i = 0; i < n; i++) sys.param[i].val = refVals[k*n + i];
+        Slvs_Solve(&sys, 2);
+        for(int i = 0; i < n; i++) refVals[k*n + i] = sys.param[i].val;
+        refResult[k] = sys.result;
+        refDof[k] = sys.dof;
+    }
+    CHECK_TRUE(refResult[0] == SLVS_RESULT_OKAY);
+    CHECK_TRUE(refResult[1] == SLVS_RESULT_OKAY);
+    CHECK_TRUE(refResult[2] == SLVS_RESULT_OKAY);
+    CHECK_TRUE(refResult[3] != SLVS_RESULT_OKAY);
+    CHECK_TRUE(fabs(refVals[1*n + ParamIndex(sys, 20)] - 5.0) < LENGTH_EPS);
+    CHECK_TRUE(fabs(refVals[1*n + ParamIndex(sys, 21)] - 3.0) < LENGTH_EPS);
+    CHECK_TRUE(refVals[2*n + ParamIndex(sys, 25)] < 0.0);
+
+    std::vector<int> result(count, -1), dof(count, -1);
+    Slvs_SolveBatch(&sys, 2, count, &vals[0], &result[0], &dof[0]);
+    for(int k = 0; k < count; k++) {
+        CHECK_TRUE(result[k] == refResult[k]);
+        // Only a solution has a meaningful dof and params.
+        if(refResult[k] != SLVS_RESULT_OKAY) continue;
+        CHECK_TRUE(dof[k] == refDof[k]);
+        for(int i = 0; i < n; i++) {
+            CHECK_TRUE(fabs(vals[k*n + i] - refVals[k*n + i]) < LENGTH_EPS);
+        }
+    }
+
+    // A system that can't be written at all gets a result for every set.
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+            6, 2, 0, 200, 0.0, 401, 402, 0, 0);
+    std::fill(result.begin(), result.end(), -1);
+    Slvs_SolveBatch(&sys, 2, count, &vals[0], &result[0], NULL);
+    for(int k = 0; k < count; k++) {
+        CHECK_TRUE(result[k] == SLVS_RESULT_UNRECOGNIZED);
+    }
+}
+
+struct SweepSteps {
+    int                 n;
+    std::vector<double> vals;
+    std::vector<double> params;
+    std::vector<int>    result;
+};
+
+static int RecordStep(void *data, int step, double val, const Slvs_System *sys) {
+    SweepSteps *steps = (SweepSteps *)data;
+    CHECK_TRUE(step == (int)steps->result.size());
+    steps->vals.push_back(val);
+    for(int i = 0; i < steps->n; i++) steps->params.push_back(sys->param[i].val);
+    steps->result.push_back(sys->result);
+    return 0;
+}
+
+static void TestSweep() {
+    Slvs_System sys = MakeTriangle();
+    int n = sys.params;
+    std::vector<double> start;
+    for(int i = 0; i < n; i++) start.push_back(sys.param[i].val);
+
+    // Swing C in from where the sketch was dimensioned, to near the limit
+    // of the triangle inequality.
+    SweepSteps steps = {};
+    steps.n = n;
+    const int count = 50;
+    Slvs_Sweep(&sys, 2, 4, 20.0, 6.0, count, RecordStep, &steps);
+    CHECK_TRUE((int)steps.result.size() == count);
+
+    // The reference, from solving each step by itself, starting from the
+    // solution to the step before.
+    for(int i = 0; i < n; i++) sys.param[i].val = start[i];
+    for(int k = 0; k < (int)steps.result.size(); k++) {
+        sys.constraint[3].valA = steps.vals[k];
+        Slvs_Solve(&sys, 2);
+        CHECK_TRUE(sys.result == SLVS_RESULT_OKAY);
+        CHECK_TRUE(steps.result[k] == sys.result);
+        for(int i = 0; i < n; i++) {
+            CHECK_TRUE(fabs(steps.params[k*n + i] - sys.param[i].val) < LENGTH_EPS);
+        }
+    }
+    CHECK_TRUE(fabs(steps.vals[0] - 20.0) < LENGTH_EPS);
+    CHECK_TRUE(fabs(steps.vals[count - 1] - 6.0) < LENGTH_EPS);
+}
+
+// A workplane whose origin is a little off the 3d origin, by less than the
+// solver's tolerances; and in group 2, a point in that workplane at a given
+// distance from the 3d origin. The workplane is constant when solving group
+// 2, but its small offset still has to be taken in to account.
+static void TestSmallConstant() {
+    Slvs_System sys = {};
+    sys.param      = param;
+    sys.entity     = entity;
+    sys.constraint = constraint;
+
+    Slvs_hGroup g = 1;
+    double qw, qx, qy, qz;
+    sys.param[sys.params++] = Slvs_MakeParam(1, g, 0.0);
+    sys.param[sys.params++] = Slvs_MakeParam(2, g, 0.0);
+    sys.param[sys.params++] = Slvs_MakeParam(3, g, 0.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint3d(101, g, 1, 2, 3);
+    sys.param[sys.params++] = Slvs_MakeParam(4, g, 0.0005);
+    sys.param[sys.params++] = Slvs_MakeParam(5, g, 0.0);
+    sys.param[sys.params++] = Slvs_MakeParam(6, g, 0.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint3d(102, g, 4, 5, 6);
+    Slvs_MakeQuaternion(1, 0, 0,
+                        0, 1, 0, &qw, &qx, &qy, &qz);
+    sys.param[sys.params++] = Slvs_MakeParam(7, g, qw);
+    sys.param[sys.params++] = Slvs_MakeParam(8, g, qx);
+    sys.param[sys.params++] = Slvs_MakeParam(9, g, qy);
+    sys.param[sys.params++] = Slvs_MakeParam(10, g, qz);
+    sys.entity[sys.entities++] = Slvs_MakeNormal3d(103, g, 7, 8, 9, 10);
+    sys.entity[sys.entities++] = Slvs_MakeWorkplane(200, g, 102, 103);
+
+    g = 2;
+    sys.param[sys.params++] = Slvs_MakeParam(20, g, 9.0);
+    sys.param[sys.params++] = Slvs_MakeParam(21, g, 0.0);
+    sys.entity[sys.entities++] = Slvs_MakePoint2d(301, g, 200, 20, 21);
+    sys.constraint[sys.constraints++] = Slvs_MakeConstraint(
+            1, g, SLVS_C_PT_PT_DISTANCE, SLVS_FREE_IN_3D, 10.0, 101, 301, 0, 0);
+
+    Slvs_Solve(&sys, 2);
+    CHECK_TRUE(sys.result == SLVS_RESULT_OKAY);
+    double x = 0.0005 + sys.param[ParamIndex(sys, 20)].val,
+           y = sys.param[ParamIndex(sys, 21)].val;
+    CHECK_TRUE(fabs(sqrt(x*x + y*y) - 10.0) < LENGTH_EPS);
+
+    // And the same through a batch, which writes the system the same way.
+    int n = sys.params;
+    std::vector<double> vals;
+    for(int i = 0; i < n; i++) vals.push_back(sys.param[i].val);
+    vals[ParamIndex(sys, 20)] = 9.0;
+    vals[ParamIndex(sys, 21)] = 0.0;
+    int result = -1;
+    Slvs_SolveBatch(&sys, 2, 1, &vals[0], &result, NULL);
+    CHECK_TRUE(result == SLVS_RESULT_OKAY);
+    x = 0.0005 + vals[ParamIndex(sys, 20)];
+    y = vals[ParamIndex(sys, 21)];
+    CHECK_TRUE(fabs(sqrt(x*x + y*y) - 10.0) < LENGTH_EPS);
+}
+
+int main() {
+    TestBatch();
+    TestSweep();
+    TestSmallConstant();
+
+    fprintf(stderr, "%d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}